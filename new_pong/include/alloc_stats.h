@@ -0,0 +1,33 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// heap allocation counter
+//
+// my_pong.cpp replaces every form of the global operator new and delete
+// (plain, nothrow and aligned) so that every C++ heap allocation is counted.
+// malloc() calls are not counted. end_frame() latches the count like
+// render_stats does.
+//
+
+class alloc_stats {
+  std::atomic<unsigned> allocations_;
+  unsigned last_allocations_;
+
+  alloc_stats() {
+    allocations_ = 0;
+    last_allocations_ = 0;
+  }
+public:
+  void allocation() { allocations_.fetch_add(1, std::memory_order_relaxed); }
+
+  void end_frame() {
+    last_allocations_ = allocations_.exchange(0, std::memory_order_relaxed);
+  }
+
+  // allocations during the last finished frame
+  unsigned allocations() const { return last_allocations_; }
+
+  static alloc_stats &get() {
+    static alloc_stats the_stats;
+    return the_stats;
+  }
+};
@@ -0,0 +1,70 @@
+// box class - holds shape and color of a box on the screen.
+class box {
+  vec4 center_;
+  vec4 half_extents_;
+  vec4 color_;
+  vec4 axis_;   // the box's x axis, (1, 0) unless it is rotated
+
+public:
+  // we don't have a constructor, but we do have an 'init' function
+  void init(float cx, float cy, float hx, float hy) {
+    // note that it is a convention for positions and colors
+    // to have "1" in the w, distances to have "0" in the w.
+    center_ = vec4(cx, cy, 0, 1);
+    half_extents_ = vec4(hx, hy, 0, 0);
+    color_ = vec4(1, 1, 1, 1);
+    axis_ = vec4(1, 0, 0, 0);
+  }
+
+  // init from the components of an entity
+  void init(const vec4 &center, const vec4 &half_extents, const vec4 &color, const vec4 &axis = vec4(1, 0, 0, 0)) {
+    center_ = center;
+    half_extents_ = half_extents;
+    color_ = color;
+    axis_ = axis;
+  }
+
+  // add the box to a sprite batch: it is drawn when the batch is flushed
+  void draw(sprite_batch &batch) {
+    batch.box(center_, half_extents_, color_, axis_);
+  }
+
+  // ...or add it as one instance of the instanced renderer
+  void draw(instanced_boxes &instances) {
+    instances.add(center_, half_extents_, color_, axis_);
+  }
+
+  // ...or record it as a render command
+  void draw(command_buffer &commands) {
+    commands.box(center_, half_extents_, color_, axis_);
+  }
+
+  // ...or draw it without GL
+  void draw(soft_rasterizer &raster) {
+    raster.box(center_, half_extents_, color_, axis_);
+  }
+
+  // move the box
+  void move(const vec4 &dir) {
+    center_ += dir;
+  }
+
+  // the 'pos' property
+  vec4 pos() const { return center_; }
+  void set_pos(vec4 v) { center_ = v; }
+
+  // the 'sides' property
+  float r_side() const {return center_[0] + half_extents_[0];}
+  float l_side() const {return center_[0] - half_extents_[0];}
+  float t_side() const {return center_[1] + half_extents_[1];}
+  float b_side() const {return center_[1] - half_extents_[1];}
+
+
+  // return true if two boxes intersect
+  bool intersects(const box &rhs) {
+    vec4 diff = (rhs.pos() - pos()).abs();
+    vec4 min_distance = rhs.half_extents_ + half_extents_;
+    return diff[0] < min_distance[0] && diff[1] < min_distance[1];
+  }
+
+};
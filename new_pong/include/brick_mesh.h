@@ -0,0 +1,166 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// retained brick geometry
+//
+// The bricks of a level sit in one static buffer of box instances, grouped
+// into spatial chunks. Each chunk keeps its standing bricks packed at the
+// start of its slice. Each draw compares the alive bits it is given with the
+// ones it last drew, and only chunks that changed are repacked and
+// re-uploaded. Clean chunks cost
+// nothing but their draw, and runs of chunks with every brick standing are
+// contiguous in the buffer, so they merge into a single draw.
+//
+
+class brick_mesh {
+  // about this many bricks per chunk
+  enum { chunk_bricks = 4096 };
+
+  const level_file *level_;
+  unsigned num_chunks_;
+
+  std::vector<unsigned> order_;         // brick indices, chunk by chunk
+  std::vector<unsigned> chunk_start_;   // first entry of each chunk in order_
+  std::vector<unsigned> chunk_of_;      // the chunk of each brick
+  std::vector<unsigned> live_;          // standing bricks at the start of each chunk's slice
+  std::vector<unsigned char> dirty_;
+  std::vector<unsigned> dirty_list_;
+  std::vector<unsigned> drawn_;         // the alive bits of the last draw
+  std::vector<instanced_boxes::instance> scratch_;
+
+  GLuint buffer_;
+  unsigned rebuilds_;
+
+  void rebuild(unsigned chunk, const unsigned *alive) {
+    const float *cx = level_->brick_cx(), *cy = level_->brick_cy();
+    const float *hx = level_->brick_hx(), *hy = level_->brick_hy();
+    const unsigned *color = level_->brick_color();
+    vec4 axis(1, 0, 0, 0);
+
+    scratch_.resize(0);
+    for (unsigned r = chunk_start_[chunk]; r != chunk_start_[chunk + 1]; ++r) {
+      unsigned i = order_[r];
+      if ((alive[i >> 5] >> (i & 31)) & 1) {
+        instanced_boxes::instance inst;
+        inst.set(vec4(cx[i], cy[i], 0, 1), vec4(hx[i], hy[i], 0, 0), axis);
+        for (int c = 0; c != 4; ++c) {
+          inst.color[c] = (unsigned char)(color[i] >> (c * 8));
+        }
+        scratch_.push_back(inst);
+      }
+    }
+
+    live_[chunk] = (unsigned)scratch_.size();
+    if (live_[chunk]) {
+      GLintptr offset = chunk_start_[chunk] * sizeof(instanced_boxes::instance);
+      gl_state::get().bind_buffer(GL_ARRAY_BUFFER, buffer_);
+      glBufferSubData(GL_ARRAY_BUFFER, offset, live_[chunk] * sizeof(instanced_boxes::instance), &scratch_[0]);
+    }
+    rebuilds_++;
+  }
+
+public:
+  brick_mesh() {
+    level_ = 0;
+    num_chunks_ = 0;
+    buffer_ = 0;
+    rebuilds_ = 0;
+  }
+
+  // split the level into chunks. The GL buffer is made on the first draw.
+  void init(const level_file &level) {
+    level_ = &level;
+    const level_header &h = level.header();
+    unsigned n = level.num_bricks();
+
+    unsigned side = 1;
+    while (side * side * chunk_bricks < n) side++;
+    num_chunks_ = side * side;
+
+    // chunk each brick by its center over the broadphase grid's area
+    const float *cx = level.brick_cx(), *cy = level.brick_cy();
+    float chunk_w = h.cell_w * h.grid_w / side, chunk_h = h.cell_h * h.grid_h / side;
+    chunk_of_.resize(n);
+    chunk_start_.assign(num_chunks_ + 1, 0);
+    for (unsigned i = 0; i != n; ++i) {
+      int x = clamp_floor((cx[i] - h.grid_x) / chunk_w, 0, side - 1);
+      int y = clamp_floor((cy[i] - h.grid_y) / chunk_h, 0, side - 1);
+      chunk_of_[i] = y * side + x;
+      chunk_start_[chunk_of_[i] + 1]++;
+    }
+    for (unsigned c = 0; c != num_chunks_; ++c) {
+      chunk_start_[c + 1] += chunk_start_[c];
+    }
+    order_.resize(n);
+    std::vector<unsigned> fill(chunk_start_.begin(), chunk_start_.end() - 1);
+    for (unsigned i = 0; i != n; ++i) {
+      order_[fill[chunk_of_[i]]++] = i;
+    }
+
+    live_.assign(num_chunks_, 0);
+    dirty_.assign(num_chunks_, 0);
+    dirty_list_.clear();
+    drawn_.assign((n + 31) / 32, 0);
+    mark_all();
+  }
+
+  // brick i has changed
+  void mark(unsigned i) {
+    unsigned c = chunk_of_[i];
+    if (!dirty_[c]) {
+      dirty_[c] = 1;
+      dirty_list_.push_back(c);
+    }
+  }
+
+  void mark_all() {
+    for (unsigned c = 0; c != num_chunks_; ++c) {
+      if (!dirty_[c]) {
+        dirty_[c] = 1;
+        dirty_list_.push_back(c);
+      }
+    }
+  }
+
+  // chunks rebuilt so far
+  unsigned rebuilds() const { return rebuilds_; }
+
+  // rebuild the dirty chunks, then draw everything from the resident buffer.
+  // alive is one bit per brick.
+  void draw(instanced_boxes &instances, const unsigned *alive) {
+    if (!order_.size()) return;
+    if (!buffer_) {
+      glGenBuffers(1, &buffer_);
+      gl_state::get().bind_buffer(GL_ARRAY_BUFFER, buffer_);
+      glBufferData(GL_ARRAY_BUFFER, order_.size() * sizeof(instanced_boxes::instance), NULL, GL_STATIC_DRAW);
+    }
+
+    // bricks that were knocked out or put back since the last draw.
+    // the bits past the last brick are not bricks.
+    unsigned n = (unsigned)order_.size();
+    for (unsigned w = 0; w != drawn_.size(); ++w) {
+      unsigned changed = drawn_[w] ^ alive[w];
+      if (!changed) continue;
+      drawn_[w] = alive[w];
+      for (unsigned b = 0; b != 32 && w * 32 + b < n; ++b) {
+        if ((changed >> b) & 1) mark(w * 32 + b);
+      }
+    }
+
+    for (size_t d = 0; d != dirty_list_.size(); ++d) {
+      rebuild(dirty_list_[d], alive);
+      dirty_[dirty_list_[d]] = 0;
+    }
+    dirty_list_.clear();
+
+    // a full chunk runs straight on into the next one
+    unsigned run_start = 0, run_count = 0;
+    for (unsigned c = 0; c != num_chunks_; ++c) {
+      if (!run_count) run_start = chunk_start_[c];
+      run_count += live_[c];
+      if (live_[c] != chunk_start_[c + 1] - chunk_start_[c] || c + 1 == num_chunks_) {
+        instances.draw(buffer_, run_start * sizeof(instanced_boxes::instance), run_count);
+        run_count = 0;
+      }
+    }
+  }
+};
@@ -0,0 +1,230 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// render commands
+//
+// The world is recorded as small POD commands instead of being drawn while
+// the game objects are walked. Each command carries a 64 bit sort key:
+//
+//   layer 8 | pipeline 8 | texture 16 | unused 32
+//
+// so once the frame's commands are sorted, everything that shares a pipeline
+// and texture is next to each other and the renderers change state once per
+// run, not once per object. The game is flat, so there is no depth field:
+// commands with the same state keep the order they were recorded in.
+//
+// Recording follows the sprite_batch pattern: set the layer, pipeline and
+// texture, then add boxes. Commands that only need their key (a retained
+// mesh, the particle batch) are draw()n with no geometry.
+//
+// Every thread that records has a command_buffer of its own, so recording
+// needs no locks. render_queue gathers the buffers, sorts (key, buffer,
+// index) entries with a stable LSD radix sort that skips the bytes every
+// key shares, and hands the commands back in order: commands with equal
+// keys keep the order they were recorded in, buffer by buffer.
+//
+
+// drawn in this order
+enum render_layer {
+  layer_background,
+  layer_world,
+  layer_effects,
+  layer_overlay,
+};
+
+// which renderer a command goes to
+enum render_pipeline {
+  pipeline_sprite,      // sprite_batch quads
+  pipeline_bricks,      // the retained brick mesh
+  pipeline_boxes,       // instanced_boxes
+  pipeline_particles,   // particle_batch
+};
+
+// one draw, 56 bytes
+struct render_command {
+  unsigned long long key;
+  float cx, cy;               // center
+  float hx, hy;               // half extents
+  float ax, ay;               // the x axis
+  float u0, v0, u1, v1;       // texture coordinates, when the key has a texture
+  unsigned color;             // RGBA8, as pack_color
+  unsigned pad;
+
+  static unsigned long long make_key(render_layer layer, render_pipeline pipeline, unsigned texture) {
+    return
+      (unsigned long long)(layer & 0xff) << 56 |
+      (unsigned long long)(pipeline & 0xff) << 48 |
+      (unsigned long long)(texture & 0xffff) << 32
+    ;
+  }
+
+  render_layer layer() const { return (render_layer)(key >> 56); }
+  render_pipeline pipeline() const { return (render_pipeline)(key >> 48 & 0xff); }
+  GLuint texture() const { return (GLuint)(key >> 32 & 0xffff); }
+
+  vec4 center() const { return vec4(cx, cy, 0, 1); }
+  vec4 half_extents() const { return vec4(hx, hy, 0, 0); }
+  vec4 axis() const { return vec4(ax, ay, 0, 0); }
+};
+
+// the commands recorded by one thread
+class command_buffer {
+  std::vector<render_command> commands_;
+  unsigned long long key_;
+  render_layer layer_;
+  render_pipeline pipeline_;
+  unsigned texture_;
+
+  void update_key() { key_ = render_command::make_key(layer_, pipeline_, texture_); }
+
+  render_command &push() {
+    commands_.push_back(render_command());
+    render_command &c = commands_.back();
+    c.key = key_;
+    c.pad = 0;
+    return c;
+  }
+public:
+  command_buffer() {
+    layer_ = layer_world;
+    pipeline_ = pipeline_sprite;
+    texture_ = 0;
+    update_key();
+  }
+
+  // the commands stay allocated for the next frame
+  void clear() { commands_.clear(); }
+
+  // these set the key of the commands that follow
+  void set_layer(render_layer layer) { layer_ = layer; update_key(); }
+  void set_pipeline(render_pipeline pipeline) { pipeline_ = pipeline; update_key(); }
+
+  // texture names must fit in 16 bits. 0 is untextured.
+  void set_texture(GLuint texture) {
+    assert(texture <= 0xffff);
+    texture_ = texture;
+    update_key();
+  }
+
+  // an untextured box, rotated so that its x axis is axis
+  void box(const vec4 &center, const vec4 &half_extents, const vec4 &color, const vec4 &axis) {
+    if (texture_) set_texture(0);
+    render_command &c = push();
+    c.cx = center[0]; c.cy = center[1];
+    c.hx = half_extents[0]; c.hy = half_extents[1];
+    c.ax = axis[0]; c.ay = axis[1];
+    c.u0 = c.v0 = c.u1 = c.v1 = 0;
+    c.color = pack_color(color);
+  }
+
+  // an axis aligned rectangle from a texture atlas
+  void sprite(const atlas_region &region, const vec4 &center, const vec4 &half_extents, const vec4 &color) {
+    set_texture(region.texture);
+    render_command &c = push();
+    c.cx = center[0]; c.cy = center[1];
+    c.hx = half_extents[0]; c.hy = half_extents[1];
+    c.ax = 1; c.ay = 0;
+    c.u0 = region.u0; c.v0 = region.v0; c.u1 = region.u1; c.v1 = region.v1;
+    c.color = pack_color(color);
+  }
+
+  // a command with nothing but its key
+  void draw() {
+    render_command &c = push();
+    c.cx = c.cy = c.hx = c.hy = c.ax = c.ay = 0;
+    c.u0 = c.v0 = c.u1 = c.v1 = 0;
+    c.color = 0;
+  }
+
+  unsigned size() const { return (unsigned)commands_.size(); }
+  const render_command &operator[](unsigned i) const { return commands_[i]; }
+};
+
+// every thread's commands for one frame, in key order
+class render_queue {
+  struct entry {
+    unsigned long long key;
+    unsigned buffer;
+    unsigned index;
+  };
+
+  std::vector<command_buffer> buffers_;
+  std::vector<entry> entries_, scratch_;
+
+  // stable LSD radix sort, a byte at a time
+  void radix_sort() {
+    size_t n = entries_.size();
+    scratch_.resize(n);
+
+    // every byte's histogram in one pass
+    unsigned counts[8][256];
+    memset(counts, 0, sizeof(counts));
+    for (size_t i = 0; i != n; ++i) {
+      unsigned long long key = entries_[i].key;
+      for (int b = 0; b != 8; ++b) {
+        counts[b][key >> (b * 8) & 0xff]++;
+      }
+    }
+
+    entry *from = entries_.data(), *to = scratch_.data();
+    for (int b = 0; b != 8; ++b) {
+      // a byte every key shares does not reorder anything
+      unsigned *count = counts[b];
+      if (count[entries_[0].key >> (b * 8) & 0xff] == n) continue;
+
+      unsigned offset[256], total = 0;
+      for (int d = 0; d != 256; ++d) {
+        offset[d] = total;
+        total += count[d];
+      }
+      for (size_t i = 0; i != n; ++i) {
+        to[offset[from[i].key >> (b * 8) & 0xff]++] = from[i];
+      }
+      std::swap(from, to);
+    }
+    if (from != entries_.data()) entries_.swap(scratch_);
+  }
+
+public:
+  // one buffer for each thread that records. not thread safe itself:
+  // call between frames.
+  void init(unsigned threads) {
+    buffers_.resize(threads ? threads : 1);
+  }
+
+  // the buffer thread t records into
+  command_buffer &buffer(unsigned t) { return buffers_[t]; }
+
+  void clear() {
+    for (size_t b = 0; b != buffers_.size(); ++b) {
+      buffers_[b].clear();
+    }
+  }
+
+  // after every thread has finished recording
+  void sort() {
+    entries_.clear();
+    for (unsigned b = 0; b != buffers_.size(); ++b) {
+      const command_buffer &commands = buffers_[b];
+      for (unsigned i = 0; i != commands.size(); ++i) {
+        entry e = { commands[i].key, b, i };
+        entries_.push_back(e);
+      }
+    }
+    if (entries_.size() > 1) radix_sort();
+  }
+
+  // the sorted commands
+  unsigned size() const { return (unsigned)entries_.size(); }
+  const render_command &operator[](unsigned i) const {
+    const entry &e = entries_[i];
+    return buffers_[e.buffer][e.index];
+  }
+};
+
+// ...and particles recorded as boxes, for the sprite batch
+inline void draw_particles(command_buffer &commands, const particle_snapshot &p) {
+  vec4 half(particle_system::half_size(), particle_system::half_size(), 0, 0), axis(1, 0, 0, 0);
+  for (unsigned i = 0; i != p.size(); ++i) {
+    if (p.life[i] > 0) commands.box(vec4(p.x[i], p.y[i], 0, 1), half, unpack_color(p.color[i]), axis);
+  }
+}
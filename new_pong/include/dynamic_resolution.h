@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// dynamic resolution
+//
+// Holds the GPU frame time near a target by scaling the resolution the
+// scene is drawn at, in eighths from full size down to half. The scene goes
+// into an offscreen target at the scaled size and is drawn up to the window
+// as one sprite with a linear filter, through the sprite batch, which needs
+// nothing past GL 2 and framebuffer objects. The upscale is a full window
+// of texturing, so it only pays where the scene costs more per pixel than
+// that: on llvmpipe it costs about as much as the whole of this scene.
+//
+// The GPU time comes from gpu_timers a few frames late and is smoothed. To
+// stop the scale flapping between two levels:
+//
+//   - it drops a level only after the frame time has been over the target
+//     for drop_frames readings in a row,
+//   - it rises a level only when the cost predicted at the next level, which
+//     goes with the area, is still well under the target, and has been for
+//     raise_frames readings in a row,
+//   - after a change it waits settle_frames readings for the new level's
+//     times to come through before deciding again.
+//
+
+class dynamic_resolution {
+  enum {
+    eighths = 8,
+    min_level = 4,        // half size
+    max_level = 8,        // full size
+    drop_frames = 8,
+    raise_frames = 60,
+    settle_frames = 16,
+  };
+
+  // a rise must leave this much of the target spare
+  static double raise_headroom() { return 0.85; }
+
+  bool enabled_;
+  double target_ms_;
+  double smoothed_ms_;
+  unsigned level_;
+  unsigned over_, under_;
+  unsigned settle_;
+
+  void change_level(unsigned level) {
+    // expect the cost to follow the area until real readings come in
+    double ratio = (double)level / level_;
+    smoothed_ms_ *= ratio * ratio;
+    level_ = level;
+    over_ = under_ = 0;
+    settle_ = settle_frames;
+  }
+
+  dynamic_resolution() {
+    enabled_ = false;
+    target_ms_ = 0;
+    smoothed_ms_ = 0;
+    level_ = max_level;
+    over_ = under_ = 0;
+    settle_ = 0;
+  }
+public:
+  // scale to keep the GPU frame time under target_ms
+  void enable(double target_ms) {
+    enabled_ = true;
+    target_ms_ = target_ms;
+    gpu_timers::get().enable(false);
+  }
+
+  // the driver has no framebuffer objects
+  void disable() { enabled_ = false; level_ = max_level; }
+
+  bool enabled() const { return enabled_; }
+
+  // call once a frame with the newest GPU frame time, or a negative time if none came in
+  void update(double gpu_ms) {
+    if (!enabled_ || gpu_ms < 0) return;
+    smoothed_ms_ = smoothed_ms_ ? smoothed_ms_ * 0.8 + gpu_ms * 0.2 : gpu_ms;
+    if (settle_) {
+      settle_--;
+      return;
+    }
+
+    double next = (double)(level_ + 1) / level_;
+    if (smoothed_ms_ > target_ms_) {
+      under_ = 0;
+      if (++over_ >= drop_frames && level_ > min_level) change_level(level_ - 1);
+    } else if (level_ < max_level && smoothed_ms_ * next * next < target_ms_ * raise_headroom()) {
+      over_ = 0;
+      if (++under_ >= raise_frames) change_level(level_ + 1);
+    } else {
+      over_ = under_ = 0;
+    }
+  }
+
+  // a window dimension at the current scale, rounded up
+  int scaled(int size) const { return (size * (int)level_ + eighths - 1) / eighths; }
+  float scale() const { return (float)level_ / (float)eighths; }
+  bool full_size() const { return level_ == max_level; }
+
+  static dynamic_resolution &get() {
+    static dynamic_resolution the_scaler;
+    return the_scaler;
+  }
+};
@@ -0,0 +1,235 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// entity component system
+//
+// Entities with the same set of components share an archetype table.
+// Each component of a table lives in its own contiguous column (SoA)
+// so systems walk plain arrays instead of chasing game objects.
+//
+
+// component ids: always use enums for int constants
+enum component_t {
+  component_position,   // vec4 center, w = 1
+  component_extent,     // vec4 half extents, w = 0
+  component_color,      // vec4 rgba
+  component_velocity,   // vec4 distance per tick, w = 0
+  component_collider,   // unsigned collider_t flags
+  component_player,     // int owning player
+  component_rotation,   // quat orientation about z
+  component_spin,       // quat rotation per tick
+
+  // tags have no data, they only select the archetype
+  tag_ball,
+  tag_bat,
+  tag_obstacle,
+  tag_score,
+
+  component_count,
+};
+
+// how a ball reacts to touching a collider
+enum collider_t {
+  collide_bounce = 1,   // reflect the ball
+  collide_bat = 2,      // reflect the ball away from a player's bat
+  collide_destroy = 4,  // destroy the collider when hit
+};
+
+typedef unsigned component_mask;
+
+inline component_mask component_bit(component_t c) { return 1u << c; }
+
+// bytes per element of each component column
+inline unsigned component_size(component_t c) {
+  switch (c) {
+    case component_position:
+    case component_extent:
+    case component_color:
+    case component_velocity:
+    case component_rotation:
+    case component_spin: return sizeof(vec4);
+    case component_collider: return sizeof(unsigned);
+    case component_player: return sizeof(int);
+    default: return 0;
+  }
+}
+
+// a handle to an entity, stale handles are detected by the generation
+struct entity_id {
+  unsigned index;
+  unsigned generation;
+
+  bool operator==(const entity_id &r) const { return index == r.index && generation == r.generation; }
+  bool operator!=(const entity_id &r) const { return !(*this == r); }
+};
+
+// a table of entities that all have exactly the same components
+class archetype {
+  component_mask mask_;
+  unsigned size_;
+  unsigned capacity_;
+  unsigned char *columns_[component_count];
+  entity_id *entities_;
+
+  void grow() {
+    capacity_ = capacity_ ? capacity_ * 2 : 16;
+    for (int c = 0; c != component_count; ++c) {
+      unsigned bytes = component_size((component_t)c);
+      if ((mask_ & component_bit((component_t)c)) && bytes) {
+        columns_[c] = (unsigned char*)realloc(columns_[c], capacity_ * bytes);
+      }
+    }
+    entities_ = (entity_id*)realloc(entities_, capacity_ * sizeof(entity_id));
+  }
+public:
+  void init(component_mask mask) {
+    mask_ = mask;
+    size_ = 0;
+    capacity_ = 0;
+    memset(columns_, 0, sizeof(columns_));
+    entities_ = 0;
+  }
+
+  void release() {
+    for (int c = 0; c != component_count; ++c) {
+      free(columns_[c]);
+    }
+    free(entities_);
+    init(mask_);
+  }
+
+  component_mask mask() const { return mask_; }
+  unsigned size() const { return size_; }
+  bool has(component_t c) const { return (mask_ & component_bit(c)) != 0; }
+
+  // contiguous array of one component, one element per row
+  template <class T> T *column(component_t c) {
+    assert(has(c) && component_size(c) == sizeof(T));
+    return (T*)columns_[c];
+  }
+
+  entity_id *entities() { return entities_; }
+
+  // add a row, the components are left uninitialized
+  unsigned push(entity_id e) {
+    if (size_ == capacity_) grow();
+    entities_[size_] = e;
+    return size_++;
+  }
+
+  // remove a row by moving the last row into its place.
+  // returns the entity that now occupies the row (if any).
+  entity_id swap_remove(unsigned row) {
+    unsigned last = --size_;
+    if (row != last) {
+      for (int c = 0; c != component_count; ++c) {
+        unsigned bytes = component_size((component_t)c);
+        if (columns_[c] && bytes) {
+          memcpy(columns_[c] + row * bytes, columns_[c] + last * bytes, bytes);
+        }
+      }
+      entities_[row] = entities_[last];
+    }
+    return entities_[row];
+  }
+};
+
+// the world owns all archetype tables and maps entities to table rows
+class world {
+  enum { max_archetypes = 32 };
+
+  struct slot {
+    unsigned archetype;
+    unsigned row;
+    unsigned generation;
+    unsigned next_free;
+  };
+
+  archetype archetypes_[max_archetypes];
+  unsigned num_archetypes_;
+
+  slot *slots_;
+  unsigned num_slots_;
+  unsigned slot_capacity_;
+  unsigned first_free_;
+
+  enum { no_slot = ~0u };
+
+  unsigned find_archetype(component_mask mask) {
+    for (unsigned a = 0; a != num_archetypes_; ++a) {
+      if (archetypes_[a].mask() == mask) return a;
+    }
+    assert(num_archetypes_ != max_archetypes);
+    archetypes_[num_archetypes_].init(mask);
+    return num_archetypes_++;
+  }
+public:
+  world() {
+    num_archetypes_ = 0;
+    slots_ = 0;
+    num_slots_ = 0;
+    slot_capacity_ = 0;
+    first_free_ = no_slot;
+  }
+
+  ~world() {
+    for (unsigned a = 0; a != num_archetypes_; ++a) {
+      archetypes_[a].release();
+    }
+    free(slots_);
+  }
+
+  // make a new entity, its components must be set by the caller
+  entity_id create(component_mask mask) {
+    unsigned index;
+    if (first_free_ != no_slot) {
+      index = first_free_;
+      first_free_ = slots_[index].next_free;
+    } else {
+      if (num_slots_ == slot_capacity_) {
+        slot_capacity_ = slot_capacity_ ? slot_capacity_ * 2 : 16;
+        slots_ = (slot*)realloc(slots_, slot_capacity_ * sizeof(slot));
+      }
+      index = num_slots_++;
+      slots_[index].generation = 0;
+    }
+    slot &s = slots_[index];
+    entity_id e = { index, s.generation };
+    s.archetype = find_archetype(mask);
+    s.row = archetypes_[s.archetype].push(e);
+    s.next_free = no_slot;
+    return e;
+  }
+
+  bool alive(entity_id e) const {
+    return e.index < num_slots_ && slots_[e.index].generation == e.generation;
+  }
+
+  void destroy(entity_id e) {
+    if (!alive(e)) return;
+    slot &s = slots_[e.index];
+    entity_id moved = archetypes_[s.archetype].swap_remove(s.row);
+    if (moved != e) {
+      slots_[moved.index].row = s.row;
+    }
+    s.generation++;
+    s.next_free = first_free_;
+    first_free_ = e.index;
+  }
+
+  // access one component of one entity
+  template <class T> T &get(entity_id e, component_t c) {
+    assert(alive(e));
+    slot &s = slots_[e.index];
+    return archetypes_[s.archetype].column<T>(c)[s.row];
+  }
+
+  // call f(archetype&) for every non-empty table that has all the components in mask
+  template <class F> void each(component_mask mask, F f) {
+    for (unsigned a = 0; a != num_archetypes_; ++a) {
+      archetype &t = archetypes_[a];
+      if ((t.mask() & mask) == mask && t.size()) {
+        f(t);
+      }
+    }
+  }
+};
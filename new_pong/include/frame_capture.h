@@ -0,0 +1,364 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// frame capture
+//
+// Records the game as it is drawn without waiting for the GPU. Each frame,
+// glReadPixels copies the finished image into a free pixel pack buffer and a
+// fence goes in after it, so the copy just joins the queue of GPU work. A
+// frame or two later, once the fence has signalled, the buffer goes to a
+// worker thread that encodes it and then hands the buffer back.
+//
+// With ARB_buffer_storage every buffer is mapped once, persistently, and the
+// worker reads the pixels straight out of it: the render thread only issues
+// the read and polls fences. Without it the render thread maps the buffer
+// and copies the frame out for the worker.
+//
+// A name ending in .y4m is written as raw 4:2:0 video (ffmpeg and most
+// players read it); any other name is a printf pattern for a PNG sequence,
+// with one unsigned conversion for the frame number (shot.png is taken as
+// shot_%05u.png):
+//
+//   my_pong --capture run.y4m [--capture-fps 60]
+//   my_pong --capture shot_%05u.png
+//
+// When every buffer is busy, the frame is dropped rather than waited for,
+// and counted; headless runs wait instead, so that they record every frame.
+// The first frame fixes the size; frames of any other size are dropped too.
+//
+
+class frame_capture {
+  enum { num_slots = 8 };
+
+  // a pixel pack buffer and the frame in it
+  struct slot {
+    GLuint buffer;
+    GLsync fence;               // after the read, until it is collected
+    unsigned char *pixels;      // the persistent mapping or a copy. BGRA, bottom row first
+    unsigned frame;
+  };
+
+  const char *path_;            // the .y4m name, or pattern_
+  char pattern_[256];           // the PNG names, with one unsigned conversion
+  bool y4m_;
+  int fps_;
+  bool wait_;
+  int width_, height_;          // 0 until the first frame
+  bool persistent_;
+  FILE *file_;
+
+  slot slots_[num_slots];
+  std::deque<unsigned> reading_;  // slots the GPU is reading into, oldest first
+  unsigned frame_;
+
+  // shared with the worker, guarded by mutex_
+  std::vector<unsigned> free_;
+  std::deque<unsigned> queue_;    // slots to encode, in frame order
+  bool quit_;
+  std::thread worker_;
+  std::mutex mutex_;
+  std::condition_variable wake_, freed_;
+
+  // the worker's own
+  std::vector<unsigned char> out_;
+
+  unsigned captured_, dropped_;
+  double ms_total_, ms_max_;
+
+  size_t frame_bytes() const { return (size_t)width_ * height_ * 4; }
+
+  void start(int width, int height) {
+    width_ = width;
+    height_ = height;
+    size_t len = strlen(path_);
+    y4m_ = len >= 4 && !strcmp(path_ + len - 4, ".y4m");
+    if (y4m_) {
+      file_ = fopen(path_, "wb");
+      if (!file_) {
+        printf("capture: can't write %s\n", path_);
+        path_ = 0;
+        return;
+      }
+      fprintf(file_, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps_);
+    }
+
+    gl_state &gl = gl_state::get();
+    persistent_ = gl_has_buffer_storage();
+    for (unsigned i = 0; i != num_slots; ++i) {
+      slot &s = slots_[i];
+      glGenBuffers(1, &s.buffer);
+      gl.bind_buffer(GL_PIXEL_PACK_BUFFER, s.buffer);
+      if (persistent_) {
+        GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        gl_buffer_storage()(GL_PIXEL_PACK_BUFFER, frame_bytes(), NULL, flags);
+        s.pixels = (unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame_bytes(), flags);
+      } else {
+        glBufferData(GL_PIXEL_PACK_BUFFER, frame_bytes(), NULL, GL_STREAM_READ);
+        s.pixels = (unsigned char*)malloc(frame_bytes());
+      }
+      s.fence = 0;
+      free_.push_back(i);
+    }
+    gl.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+    worker_ = std::thread(&frame_capture::worker, this);
+  }
+
+  // pass the oldest read on to the worker. returns false if it is not done yet.
+  bool collect(bool wait) {
+    slot &s = slots_[reading_.front()];
+    GLenum result = glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000ull : 0);
+    if (result == GL_TIMEOUT_EXPIRED) return false;
+    glDeleteSync(s.fence);
+    s.fence = 0;
+
+    if (!persistent_) {
+      gl_state::get().bind_buffer(GL_PIXEL_PACK_BUFFER, s.buffer);
+      const void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame_bytes(), GL_MAP_READ_BIT);
+      if (mapped) {
+        memcpy(s.pixels, mapped, frame_bytes());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      }
+      gl_state::get().bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(reading_.front());
+    reading_.pop_front();
+    wake_.notify_one();
+    return true;
+  }
+
+  // a free slot, or num_slots if there is none and we should not wait
+  unsigned take_slot() {
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!free_.empty()) {
+          unsigned i = free_.back();
+          free_.pop_back();
+          return i;
+        }
+        if (!wait_) return num_slots;
+        if (reading_.empty()) {
+          // everything is with the worker
+          freed_.wait(lock);
+          continue;
+        }
+      }
+      collect(true);
+    }
+  }
+
+  // BT.601 limited range, chroma averaged over each 2x2 block
+  void write_y4m(const unsigned char *bgra) {
+    int w = width_, h = height_, cw = (w + 1) / 2, ch = (h + 1) / 2;
+    out_.resize((size_t)w * h + (size_t)cw * ch * 2);
+    unsigned char *y_plane = &out_[0], *u_plane = y_plane + w * h, *v_plane = u_plane + cw * ch;
+
+    // GL rows run bottom up, video rows top down
+    for (int y = 0; y != h; ++y) {
+      const unsigned char *src = bgra + (size_t)(h - 1 - y) * w * 4;
+      unsigned char *dest = y_plane + (size_t)y * w;
+      for (int x = 0; x != w; ++x, src += 4) {
+        dest[x] = (unsigned char)(16 + ((66 * src[2] + 129 * src[1] + 25 * src[0] + 128) >> 8));
+      }
+    }
+    for (int y = 0; y != ch; ++y) {
+      for (int x = 0; x != cw; ++x) {
+        int r = 0, g = 0, b = 0, n = 0;
+        for (int dy = 0; dy != 2; ++dy) {
+          for (int dx = 0; dx != 2; ++dx) {
+            int px = x * 2 + dx, py = y * 2 + dy;
+            if (px >= w || py >= h) continue;
+            const unsigned char *p = bgra + ((size_t)(h - 1 - py) * w + px) * 4;
+            b += p[0]; g += p[1]; r += p[2]; n++;
+          }
+        }
+        r /= n; g /= n; b /= n;
+        u_plane[y * cw + x] = (unsigned char)(128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8));
+        v_plane[y * cw + x] = (unsigned char)(128 + ((112 * r - 94 * g - 18 * b + 128) >> 8));
+      }
+    }
+    fputs("FRAME\n", file_);
+    fwrite(&out_[0], out_.size(), 1, file_);
+  }
+
+  void write_png(const unsigned char *bgra, unsigned frame) {
+    // flip to top row first and swap to RGBA
+    out_.resize(frame_bytes());
+    for (int y = 0; y != height_; ++y) {
+      const unsigned char *src = bgra + (size_t)(height_ - 1 - y) * width_ * 4;
+      unsigned char *dest = &out_[(size_t)y * width_ * 4];
+      for (int x = 0; x != width_; ++x, src += 4, dest += 4) {
+        dest[0] = src[2]; dest[1] = src[1]; dest[2] = src[0]; dest[3] = src[3];
+      }
+    }
+    char name[256];
+    sprintf_s(name, sizeof(name), path_, frame);
+    if (!png_file::write(name, &out_[0], width_, height_)) printf("capture: can't write %s\n", name);
+  }
+
+  // encode frames in order until told to stop and the queue is empty
+  void worker() {
+    for (;;) {
+      unsigned i;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (queue_.empty() && !quit_) wake_.wait(lock);
+        if (queue_.empty()) return;
+        i = queue_.front();
+        queue_.pop_front();
+      }
+
+      if (y4m_) write_y4m(slots_[i].pixels); else write_png(slots_[i].pixels, slots_[i].frame);
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      free_.push_back(i);
+      captured_++;
+      freed_.notify_one();
+    }
+  }
+
+  void stop_worker() {
+    if (!worker_.joinable()) return;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      quit_ = true;
+      wake_.notify_one();
+    }
+    worker_.join();
+  }
+
+  // a PNG name may have one unsigned conversion for the frame number (%u,
+  // %05u...) and no other. a name without one gets _%05u before its extension.
+  bool set_pattern(const char *path) {
+    int frame_numbers = 0;
+    for (const char *p = path; *p; ++p) {
+      if (*p != '%') continue;
+      if (*++p == '%') continue;
+      p += strspn(p, "-+ #0");
+      p += strspn(p, "0123456789.");
+      if (*p != 'u') return false;
+      frame_numbers++;
+    }
+    if (frame_numbers > 1) return false;
+
+    size_t len = strlen(path), stem = len;
+    if (!frame_numbers) {
+      const char *dot = strrchr(path, '.');
+      if (dot && !strpbrk(dot, "/\\")) stem = dot - path;
+    }
+    int written = frame_numbers ?
+      sprintf_s(pattern_, sizeof(pattern_), "%s", path) :
+      sprintf_s(pattern_, sizeof(pattern_), "%.*s_%%05u%s", (int)stem, path, path + stem)
+    ;
+    return written > 0 && written < (int)sizeof(pattern_);
+  }
+
+  frame_capture() {
+    path_ = 0;
+    pattern_[0] = 0;
+    y4m_ = false;
+    fps_ = 60;
+    wait_ = false;
+    width_ = height_ = 0;
+    persistent_ = false;
+    file_ = 0;
+    frame_ = 0;
+    quit_ = false;
+    captured_ = dropped_ = 0;
+    ms_total_ = ms_max_ = 0;
+  }
+
+  ~frame_capture() {
+    stop_worker();
+  }
+public:
+  // false if path is not a name it can write
+  bool enable(const char *path, int fps = 60) {
+    size_t len = strlen(path);
+    if (len >= 4 && !strcmp(path + len - 4, ".y4m")) {
+      path_ = path;
+    } else if (set_pattern(path)) {
+      path_ = pattern_;
+    } else {
+      printf("capture: %s may only have one %%u for the frame number\n", path);
+      path_ = 0;
+    }
+    fps_ = fps > 0 ? fps : 60;
+    return path_ != 0;
+  }
+
+  bool enabled() const { return path_ != 0; }
+
+  // wait for a free buffer instead of dropping the frame
+  void wait_for_encoder(bool wait) { wait_ = wait; }
+
+  // call once a frame, after drawing and before the swap: reads the
+  // bound framebuffer. needs sync objects (GL 3.2).
+  void capture(int width, int height) {
+    if (!path_) return;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+    if (!width_) start(width, height);
+    if (!path_) return;
+    unsigned frame = frame_++;
+    if (width != width_ || height != height_) {
+      dropped_++;
+      return;
+    }
+
+    // pass on every read that is done
+    while (!reading_.empty() && collect(false)) {}
+
+    unsigned i = take_slot();
+    if (i == num_slots) {
+      dropped_++;
+    } else {
+      // BGRA is the layout most drivers keep, so the copy needs no swizzle
+      slot &s = slots_[i];
+      s.frame = frame;
+      gl_state::get().bind_buffer(GL_PIXEL_PACK_BUFFER, s.buffer);
+      glReadPixels(0, 0, width_, height_, GL_BGRA, GL_UNSIGNED_BYTE, (void*)0);
+      gl_state::get().bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+      s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      reading_.push_back(i);
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    ms_total_ += ms;
+    ms_max_ = ms > ms_max_ ? ms : ms_max_;
+  }
+
+  // collect what is still in flight, let the worker finish and close the
+  // file. needs the GL context to be current.
+  void finish() {
+    if (!path_ || !width_) return;
+    while (!reading_.empty()) collect(true);
+    stop_worker();
+    if (file_) fclose(file_);
+    file_ = 0;
+
+    gl_state &gl = gl_state::get();
+    for (unsigned i = 0; i != num_slots; ++i) {
+      if (persistent_) {
+        gl.bind_buffer(GL_PIXEL_PACK_BUFFER, slots_[i].buffer);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      } else {
+        free(slots_[i].pixels);
+      }
+      gl.delete_buffer(slots_[i].buffer);
+    }
+    gl.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    printf(
+      "capture: %u frames to %s, %u dropped, %.3fms mean %.3fms max on the render thread\n",
+      captured_, path_, dropped_, frame_ ? ms_total_ / frame_ : 0.0, ms_max_
+    );
+    path_ = 0;
+  }
+
+  static frame_capture &get() {
+    static frame_capture the_capture;
+    return the_capture;
+  }
+};
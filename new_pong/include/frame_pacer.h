@@ -0,0 +1,224 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// frame pacing
+//
+// frame_pacer decides when the next frame starts:
+//
+//   vsync      swap interval 1, the next frame starts as soon as a swap returns
+//   adaptive   swap interval -1 where the driver has it: late frames tear
+//              rather than wait a whole refresh
+//   fixed      frames start on a fixed grid of deadlines: sleep until just
+//              before one, then spin. Deadlines do not drift with render time.
+//   uncapped   swap interval 0, as fast as possible
+//
+// The swap interval is set with wglSwapIntervalEXT on Windows and GLX swap
+// control on Linux. Where neither is available (macOS, Wayland) vsync and
+// adaptive fall back to fixed.
+//
+// The simulation runs on its own thread at its own tick rate whatever the
+// mode (see pong_game.h).
+//
+// Every frame's start-to-start time goes into a frame_histogram.
+//
+
+// frame times in buckets of 10us, up to 100ms
+class frame_histogram {
+  enum { num_buckets = 10000 };
+
+  static double bucket_ms() { return 0.01; }
+
+  std::vector<unsigned> buckets_;
+  unsigned count_;
+  double total_ms_;
+  double max_ms_;
+public:
+  frame_histogram() {
+    buckets_.assign(num_buckets + 1, 0);
+    count_ = 0;
+    total_ms_ = max_ms_ = 0;
+  }
+
+  void add(double ms) {
+    int bucket = (int)(ms / bucket_ms());
+    bucket = bucket < 0 ? 0 : bucket > num_buckets ? num_buckets : bucket;
+    buckets_[bucket]++;
+    count_++;
+    total_ms_ += ms;
+    max_ms_ = ms > max_ms_ ? ms : max_ms_;
+  }
+
+  void clear() {
+    buckets_.assign(num_buckets + 1, 0);
+    count_ = 0;
+    total_ms_ = max_ms_ = 0;
+  }
+
+  // the time that fraction p of the frames were at or under (top of the bucket)
+  double percentile(double p) const {
+    if (!count_) return 0;
+    unsigned target = (unsigned)ceil(p * count_), seen = 0;
+    target = target ? target : 1;
+    for (unsigned i = 0; i != num_buckets; ++i) {
+      seen += buckets_[i];
+      if (seen >= target) return (i + 1) * bucket_ms();
+    }
+    return max_ms_;
+  }
+
+  unsigned count() const { return count_; }
+  double mean() const { return count_ ? total_ms_ / count_ : 0; }
+  double max() const { return max_ms_; }
+
+  void print(FILE *file = stdout) const {
+    fprintf(
+      file, "%u frames: mean %.3fms, p50 %.2fms, p99 %.2fms, max %.3fms\n",
+      count_, mean(), percentile(0.5), percentile(0.99), max_ms_
+    );
+  }
+
+  // every non-empty bucket as csv: bucket start in ms, frames
+  bool write(const char *filename) const {
+    FILE *file = fopen(filename, "w");
+    if (!file) return false;
+    fprintf(file, "ms,frames\n");
+    for (unsigned i = 0; i != num_buckets + 1; ++i) {
+      if (buckets_[i]) fprintf(file, "%.2f,%u\n", i * bucket_ms(), buckets_[i]);
+    }
+    return fclose(file) == 0;
+  }
+};
+
+enum pacing_mode {
+  pacing_vsync,
+  pacing_adaptive,
+  pacing_fixed,
+  pacing_uncapped,
+};
+
+class frame_pacer {
+  typedef std::chrono::steady_clock clock;
+
+  pacing_mode mode_;
+  clock::duration period_;       // fixed mode
+  clock::time_point deadline_;   // fixed mode: when the next frame starts
+  clock::time_point last_frame_;
+  double last_frame_ms_;
+  frame_histogram histogram_;
+
+  // how long before a deadline to stop sleeping and start spinning
+  static clock::duration spin_time() { return std::chrono::microseconds(2000); }
+
+  static bool set_swap_interval(int interval) {
+    #if defined(WIN32)
+      typedef BOOL (WINAPI *swap_interval_fn)(int);
+      swap_interval_fn swap_interval = (swap_interval_fn)wglGetProcAddress("wglSwapIntervalEXT");
+      return swap_interval && swap_interval(interval);
+    #elif defined(GLX_VERSION_1_4)
+      // freeglut on X11. a negative interval without swap_control_tear is
+      // an X error, which ends the program, so ask first.
+      Display *display = glXGetCurrentDisplay();
+      GLXDrawable drawable = glXGetCurrentDrawable();
+      if (!display || !drawable) return false;
+      const char *extensions = glXQueryExtensionsString(display, DefaultScreen(display));
+      bool tear = gl_name_in_list(extensions, "GLX_EXT_swap_control_tear");
+      if (gl_name_in_list(extensions, "GLX_EXT_swap_control") && (interval >= 0 || tear)) {
+        PFNGLXSWAPINTERVALEXTPROC swap_interval = (PFNGLXSWAPINTERVALEXTPROC)glXGetProcAddressARB((const GLubyte*)"glXSwapIntervalEXT");
+        if (swap_interval) {
+          swap_interval(display, drawable, interval);
+          return true;
+        }
+      }
+      if (gl_name_in_list(extensions, "GLX_MESA_swap_control") && interval >= 0) {
+        PFNGLXSWAPINTERVALMESAPROC swap_interval = (PFNGLXSWAPINTERVALMESAPROC)glXGetProcAddressARB((const GLubyte*)"glXSwapIntervalMESA");
+        return swap_interval && swap_interval((unsigned)interval) == 0;
+      }
+      return false;
+    #else
+      return false;
+    #endif
+  }
+
+  frame_pacer() {
+    mode_ = pacing_fixed;
+    period_ = std::chrono::milliseconds(30);
+    last_frame_ms_ = 0;
+  }
+public:
+  // needs a current context for the swap interval
+  void set_mode(pacing_mode mode, double fixed_hz = 0) {
+    mode_ = mode;
+    if (fixed_hz > 0) {
+      period_ = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / fixed_hz));
+    }
+
+    #ifdef WIN32
+      // let sleep() wake within a millisecond
+      timeBeginPeriod(1);
+    #endif
+
+    bool ok = true;
+    switch (mode) {
+      case pacing_vsync: ok = set_swap_interval(1); break;
+      case pacing_adaptive: ok = set_swap_interval(-1) || set_swap_interval(1); break;
+      case pacing_fixed:
+      case pacing_uncapped: set_swap_interval(0); break;
+    }
+    if (!ok) {
+      // without control of the swap interval, pace to the clock instead
+      printf("no swap interval control on this platform: pacing to a fixed rate\n");
+      mode_ = pacing_fixed;
+    }
+  }
+
+  pacing_mode mode() const { return mode_; }
+
+  // wait until the next frame should start
+  void wait() {
+    if (mode_ != pacing_fixed) return;
+    clock::time_point now = clock::now();
+    if (now - deadline_ > period_) {
+      // first frame or too far behind to catch up: start the grid again
+      deadline_ = now;
+    }
+    if (deadline_ - now > spin_time()) {
+      std::this_thread::sleep_for(deadline_ - now - spin_time());
+    }
+    while (clock::now() < deadline_) {
+    }
+    deadline_ += period_;
+  }
+
+  // call once a frame after the swap
+  void frame_done() {
+    clock::time_point now = clock::now();
+    if (last_frame_ != clock::time_point()) {
+      last_frame_ms_ = std::chrono::duration<double, std::milli>(now - last_frame_).count();
+      histogram_.add(last_frame_ms_);
+    }
+    last_frame_ = now;
+  }
+
+  frame_histogram &histogram() { return histogram_; }
+  double last_frame_ms() const { return last_frame_ms_; }
+
+  // "vsync", "adaptive", "fixed", "fixed:60" or "uncapped"
+  static bool parse(const char *text, pacing_mode &mode, double &hz) {
+    hz = 0;
+    if (!strcmp(text, "vsync")) mode = pacing_vsync;
+    else if (!strcmp(text, "adaptive")) mode = pacing_adaptive;
+    else if (!strcmp(text, "uncapped")) mode = pacing_uncapped;
+    else if (!strncmp(text, "fixed", 5)) {
+      mode = pacing_fixed;
+      if (text[5] == ':') hz = atof(text + 6);
+      else if (text[5]) return false;
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  static frame_pacer &get() {
+    static frame_pacer the_pacer;
+    return the_pacer;
+  }
+};
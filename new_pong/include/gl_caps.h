@@ -0,0 +1,107 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// driver capabilities
+//
+// Optional paths (instancing, persistent mapping...) ask here once at init
+// and fall back to plain GL 2 when the driver says no.
+//
+
+// on Windows glew fetches the entry points of whatever context is current.
+// call once a context is current, before any other GL.
+inline void gl_load_entry_points() {
+  #ifdef WIN32
+    // glew only loads core profile entry points when told to, and leaves an
+    // error behind from asking for the old extension string
+    glewExperimental = GL_TRUE;
+    glewInit();
+    glGetError();
+  #endif
+}
+
+// GL_VERSION starts "major.minor", also for ES ("OpenGL ES 3.0 ...")
+inline bool gl_version_at_least(int want_major, int want_minor) {
+  const char *version = (const char*)glGetString(GL_VERSION);
+  if (!version) return false;
+  while (*version && (*version < '0' || *version > '9')) ++version;
+  int major = 0, minor = 0;
+  if (sscanf(version, "%d.%d", &major, &minor) != 2) return false;
+  return major > want_major || (major == want_major && minor >= want_minor);
+}
+
+// true if name is one of the words in a space separated list
+inline bool gl_name_in_list(const char *list, const char *name) {
+  size_t len = strlen(name);
+  for (const char *p = list; p && (p = strstr(p, name)) != 0; p += len) {
+    if ((p == list || p[-1] == ' ') && (p[len] == ' ' || p[len] == 0)) return true;
+  }
+  return false;
+}
+
+inline bool gl_has_extension(const char *name) {
+  // GL 3 lists extensions one at a time; the old single string is gone in core profiles
+  if (gl_version_at_least(3, 0)) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i != count; ++i) {
+      const char *ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+      if (ext && !strcmp(ext, name)) return true;
+    }
+    return false;
+  }
+
+  return gl_name_in_list((const char*)glGetString(GL_EXTENSIONS), name);
+}
+
+// true in a core profile (or forward compatible) context: no client arrays,
+// no default vertex array object and no GLSL 1.10.
+inline bool gl_core_profile() {
+  if (!gl_version_at_least(3, 0)) return false;
+  GLint flags = 0, mask = 0;
+  glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+  if (gl_version_at_least(3, 2)) glGetIntegerv(GL_CONTEXT_PROFILE_MASK, &mask);
+  return (mask & GL_CONTEXT_CORE_PROFILE_BIT) || (flags & GL_CONTEXT_FLAG_FORWARD_COMPATIBLE_BIT);
+}
+
+inline bool gl_has_vertex_arrays() {
+  return gl_version_at_least(3, 0) || gl_has_extension("GL_ARB_vertex_array_object");
+}
+
+// buffer storage (GL 4.4) is newer than the bundled glew, so its enums are
+// defined here and on Windows the entry point is looked up at run time
+#ifndef GL_ARB_buffer_storage
+  #define GL_MAP_PERSISTENT_BIT 0x0040
+  #define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void (GLAPIENTRY *gl_buffer_storage_proc)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+// glBufferStorage, or 0 if there is none. needs a current context.
+inline gl_buffer_storage_proc gl_buffer_storage() {
+  #if defined(WIN32)
+    static gl_buffer_storage_proc proc = (gl_buffer_storage_proc)wglGetProcAddress("glBufferStorage");
+  #elif defined(GL_ARB_buffer_storage)
+    static gl_buffer_storage_proc proc = glBufferStorage;
+  #else
+    static gl_buffer_storage_proc proc = 0;
+  #endif
+  return proc;
+}
+
+inline bool gl_has_buffer_storage() {
+  return (gl_version_at_least(4, 4) || gl_has_extension("GL_ARB_buffer_storage")) && gl_buffer_storage();
+}
+
+// so is KHR_parallel_shader_compile
+typedef void (GLAPIENTRY *gl_max_shader_compiler_threads_proc)(GLuint count);
+
+// glMaxShaderCompilerThreadsKHR, or 0 if there is none. needs a current context.
+inline gl_max_shader_compiler_threads_proc gl_max_shader_compiler_threads() {
+  #if defined(WIN32)
+    static gl_max_shader_compiler_threads_proc proc = (gl_max_shader_compiler_threads_proc)wglGetProcAddress("glMaxShaderCompilerThreadsKHR");
+  #elif defined(GL_KHR_parallel_shader_compile)
+    static gl_max_shader_compiler_threads_proc proc = glMaxShaderCompilerThreadsKHR;
+  #else
+    static gl_max_shader_compiler_threads_proc proc = 0;
+  #endif
+  return proc;
+}
@@ -0,0 +1,209 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// GL state cache
+//
+// A thin layer in front of the GL calls that change binding and enable
+// state. It remembers what is set and drops calls that would set the same
+// thing again. Every request is counted in render_stats as issued or
+// skipped, so the title bar shows how much the cache saves.
+//
+// Code that goes behind its back must call invalidate() afterwards.
+//
+// The element buffer, enabled attribute arrays and divisors belong to the
+// bound vertex array object, so they are remembered per vertex array: a
+// renderer that keeps its own VAO finds them as it left them.
+//
+
+class gl_state {
+  enum {
+    max_units = 8,
+    max_attribs = 16,
+    max_vertex_arrays = 8,
+  };
+
+  // what a vertex array object keeps
+  struct vertex_array_state {
+    GLuint name;
+    GLuint element_buffer;
+    GLuint attribs;               // bit i: attribute array i is enabled
+    GLuint attribs_known;         // bit i: ...and we know whether it is
+    GLuint divisors[max_attribs];
+
+    // divisors start at 0, as GL starts them, and not unknown: without
+    // instancing glVertexAttribDivisor does not exist, so it must only be
+    // called to set a divisor or to clear one that was set.
+    void forget(GLuint new_name) {
+      name = new_name;
+      element_buffer = unknown();
+      attribs = attribs_known = 0;
+      for (int i = 0; i != max_attribs; ++i) divisors[i] = 0;
+    }
+  };
+
+  // "unknown": never matches, so the next call always goes to GL
+  static GLuint unknown() { return ~0u; }
+
+  GLuint program_;
+  GLuint active_unit_;
+  GLuint textures_[max_units];
+  GLuint array_buffer_;
+  GLuint vertex_array_;
+  vertex_array_state arrays_[max_vertex_arrays];
+  vertex_array_state *va_;        // the state of vertex_array_
+  GLuint depth_test_;
+  GLuint blend_;
+  GLenum blend_src_, blend_dst_;
+  GLint viewport_[4];
+
+  // true if a call has to be made
+  static bool needed(bool differs) {
+    render_stats::get().state_call(differs);
+    return differs;
+  }
+
+  void enable(GLenum cap, GLuint &cached, bool on) {
+    if (needed(cached != (GLuint)on)) {
+      if (on) glEnable(cap); else glDisable(cap);
+      cached = on;
+    }
+  }
+
+  gl_state() {
+    invalidate();
+  }
+public:
+  // forget everything: the next call of each kind goes to GL
+  void invalidate() {
+    program_ = unknown();
+    active_unit_ = unknown();
+    for (int i = 0; i != max_units; ++i) textures_[i] = unknown();
+    array_buffer_ = vertex_array_ = unknown();
+    for (int i = 0; i != max_vertex_arrays; ++i) arrays_[i].forget(unknown());
+    va_ = &arrays_[0];
+    depth_test_ = blend_ = unknown();
+    blend_src_ = blend_dst_ = unknown();
+    viewport_[0] = viewport_[1] = viewport_[2] = viewport_[3] = -1;
+  }
+
+  void use_program(GLuint program) {
+    if (needed(program != program_)) {
+      glUseProgram(program);
+      program_ = program;
+    }
+  }
+
+  void active_texture(GLuint unit) {
+    if (needed(unit != active_unit_)) {
+      glActiveTexture(GL_TEXTURE0 + unit);
+      active_unit_ = unit;
+    }
+  }
+
+  void bind_texture(GLuint unit, GLuint texture) {
+    if (needed(texture != textures_[unit])) {
+      active_texture(unit);
+      glBindTexture(GL_TEXTURE_2D, texture);
+      textures_[unit] = texture;
+    }
+  }
+
+  void bind_buffer(GLenum target, GLuint buffer) {
+    GLuint &cached = target == GL_ELEMENT_ARRAY_BUFFER ? va_->element_buffer : array_buffer_;
+    if (target != GL_ARRAY_BUFFER && target != GL_ELEMENT_ARRAY_BUFFER) {
+      // other targets are not tracked
+      needed(true);
+      glBindBuffer(target, buffer);
+    } else if (needed(buffer != cached)) {
+      glBindBuffer(target, buffer);
+      cached = buffer;
+    }
+  }
+
+  // GL unbinds a texture when it is deleted, and may hand the name out again
+  void delete_texture(GLuint texture) {
+    for (int i = 0; i != max_units; ++i) {
+      if (textures_[i] == texture) textures_[i] = unknown();
+    }
+    glDeleteTextures(1, &texture);
+  }
+
+  // GL unbinds a buffer when it is deleted
+  void delete_buffer(GLuint buffer) {
+    if (array_buffer_ == buffer) array_buffer_ = 0;
+    for (int i = 0; i != max_vertex_arrays; ++i) {
+      if (arrays_[i].element_buffer == buffer) arrays_[i].element_buffer = unknown();
+    }
+    glDeleteBuffers(1, &buffer);
+  }
+
+  // only for drivers with vertex array objects (gl_has_vertex_arrays)
+  void bind_vertex_array(GLuint vao) {
+    if (!needed(vao != vertex_array_)) return;
+    glBindVertexArray(vao);
+    vertex_array_ = vao;
+
+    // find what we know about it, or take a free slot. past
+    // max_vertex_arrays the last slot is shared and starts from nothing.
+    for (int i = 0; i != max_vertex_arrays; ++i) {
+      if (arrays_[i].name == vao) { va_ = &arrays_[i]; return; }
+    }
+    for (int i = 0; i != max_vertex_arrays; ++i) {
+      if (arrays_[i].name == unknown() || i == max_vertex_arrays - 1) {
+        va_ = &arrays_[i];
+        va_->forget(vao);
+        return;
+      }
+    }
+  }
+
+  // point attribute index at the bound array buffer. returns its bit for enable_attribs.
+  // a divisor other than 0 needs instancing.
+  GLuint attrib_pointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer, GLuint divisor = 0) {
+    glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+    attrib_divisor(index, divisor);
+    return 1u << index;
+  }
+
+  // enable exactly the attribute arrays in mask and disable the rest
+  void enable_attribs(GLuint mask) {
+    GLuint change = ((mask ^ va_->attribs) | ~va_->attribs_known) & ((1u << max_attribs) - 1);
+    if (!needed(change != 0)) return;
+    for (GLuint i = 0; i != max_attribs && change; ++i, change >>= 1) {
+      if (change & 1) {
+        if ((mask >> i) & 1) glEnableVertexAttribArray(i); else glDisableVertexAttribArray(i);
+      }
+    }
+    va_->attribs = mask;
+    va_->attribs_known = ~0u;
+  }
+
+  void attrib_divisor(GLuint index, GLuint divisor) {
+    if (needed(divisor != va_->divisors[index])) {
+      glVertexAttribDivisor(index, divisor);
+      va_->divisors[index] = divisor;
+    }
+  }
+
+  void depth_test(bool on) { enable(GL_DEPTH_TEST, depth_test_, on); }
+  void blend(bool on) { enable(GL_BLEND, blend_, on); }
+
+  void blend_func(GLenum src, GLenum dst) {
+    if (needed(src != blend_src_ || dst != blend_dst_)) {
+      glBlendFunc(src, dst);
+      blend_src_ = src;
+      blend_dst_ = dst;
+    }
+  }
+
+  void viewport(GLint x, GLint y, GLint w, GLint h) {
+    if (needed(x != viewport_[0] || y != viewport_[1] || w != viewport_[2] || h != viewport_[3])) {
+      glViewport(x, y, w, h);
+      viewport_[0] = x; viewport_[1] = y; viewport_[2] = w; viewport_[3] = h;
+    }
+  }
+
+  static gl_state &get() {
+    static gl_state the_state;
+    return the_state;
+  }
+};
@@ -0,0 +1,160 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// ring buffer for per-frame GPU data
+//
+// One buffer split into three frames. With ARB_buffer_storage the whole
+// buffer is mapped once, persistently and coherently, and callers write
+// straight into it. Each frame ends with a fence, and a frame's third is only
+// reused once its fence has signalled, so neither side waits for the other
+// unless the GPU falls three frames behind.
+//
+// Without buffer storage, writes go to a CPU copy. commit() uploads them with
+// glBufferSubData into storage that begin_frame() has orphaned.
+//
+// Use:
+//   void *p = ring.reserve(max_bytes, 4);   // write up to available() bytes
+//   GLintptr offset = ring.commit(bytes_written);
+//   glVertexAttribPointer(..., (void*)offset);
+//
+
+class gpu_ring {
+  enum { num_frames = 3 };
+
+  GLuint buffer_;
+  char *memory_;        // the persistent mapping, or the CPU copy
+  size_t frame_size_;
+  size_t offset_;       // next free byte in this frame
+  unsigned frame_;
+  GLsync fences_[num_frames];
+  bool persistent_;
+  unsigned stalls_;
+
+  // buffers replaced by a bigger one this frame. They are deleted at the
+  // start of the next, because deleting a buffer unbinds it everywhere,
+  // and uniform blocks may still be bound to it.
+  std::vector<GLuint> retired_;
+
+  // where this frame's third starts in the buffer
+  size_t base() const { return persistent_ ? frame_ * frame_size_ : 0; }
+
+  void create(size_t frame_size) {
+    frame_size_ = frame_size;
+    glGenBuffers(1, &buffer_);
+    gl_state::get().bind_buffer(GL_ARRAY_BUFFER, buffer_);
+    if (persistent_) {
+      GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+      gl_buffer_storage()(GL_ARRAY_BUFFER, frame_size * num_frames, NULL, flags);
+      memory_ = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, frame_size * num_frames, flags);
+    } else {
+      glBufferData(GL_ARRAY_BUFFER, frame_size, NULL, GL_STREAM_DRAW);
+      memory_ = (char*)malloc(frame_size);
+    }
+  }
+
+  void destroy() {
+    if (persistent_) {
+      gl_state::get().bind_buffer(GL_ARRAY_BUFFER, buffer_);
+      glUnmapBuffer(GL_ARRAY_BUFFER);
+    } else {
+      free(memory_);
+    }
+    retired_.push_back(buffer_);
+    memory_ = 0;
+    for (int i = 0; i != num_frames; ++i) {
+      if (fences_[i]) glDeleteSync(fences_[i]);
+      fences_[i] = 0;
+    }
+  }
+
+  void wait(GLsync fence) {
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+      stalls_++;
+      do {
+        result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+      } while (result == GL_TIMEOUT_EXPIRED);
+    }
+  }
+
+public:
+  gpu_ring() {
+    buffer_ = 0;
+    memory_ = 0;
+    frame_size_ = offset_ = 0;
+    frame_ = 0;
+    memset(fences_, 0, sizeof(fences_));
+    persistent_ = false;
+    stalls_ = 0;
+  }
+
+  void init(size_t frame_size) {
+    persistent_ = gl_has_buffer_storage();
+    create(frame_size);
+  }
+
+  GLuint buffer() const { return buffer_; }
+  bool persistent() const { return persistent_; }
+
+  // times the CPU had to wait for the GPU to finish with a frame
+  unsigned stalls() const { return stalls_; }
+
+  // move to the next frame's third, waiting if the GPU still reads it
+  void begin_frame() {
+    // GL keeps the storage alive until draws already issued have used it
+    for (size_t i = 0; i != retired_.size(); ++i) {
+      gl_state::get().delete_buffer(retired_[i]);
+    }
+    retired_.clear();
+
+    frame_ = persistent_ ? (frame_ + 1) % num_frames : 0;
+    offset_ = 0;
+    if (persistent_) {
+      if (fences_[frame_]) {
+        wait(fences_[frame_]);
+        glDeleteSync(fences_[frame_]);
+        fences_[frame_] = 0;
+      }
+    } else {
+      gl_state::get().bind_buffer(GL_ARRAY_BUFFER, buffer_);
+      glBufferData(GL_ARRAY_BUFFER, frame_size_, NULL, GL_STREAM_DRAW);
+    }
+  }
+
+  // after the last draw that reads this frame's data
+  void end_frame() {
+    if (persistent_) {
+      fences_[frame_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+  }
+
+  // space for at least bytes. If the frame is full the ring is replaced by
+  // one twice the size; data committed earlier stays in the old buffer,
+  // which is retired until the next frame. create() gives the new buffer
+  // fresh storage, so it needs no orphaning.
+  void *reserve(size_t bytes, size_t align) {
+    offset_ = (offset_ + align - 1) & ~(align - 1);
+    if (offset_ + bytes > frame_size_) {
+      size_t frame_size = frame_size_ * 2;
+      while (frame_size < bytes) frame_size *= 2;
+      destroy();
+      create(frame_size);
+      frame_ = 0;
+      offset_ = 0;
+    }
+    return memory_ + base() + offset_;
+  }
+
+  // bytes that can be written after the last reserve()
+  size_t available() const { return frame_size_ - offset_; }
+
+  // finish writing bytes at the last reserve(); returns their offset in buffer()
+  GLintptr commit(size_t bytes) {
+    size_t offset = base() + offset_;
+    if (!persistent_ && bytes) {
+      gl_state::get().bind_buffer(GL_ARRAY_BUFFER, buffer_);
+      glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, memory_ + offset);
+    }
+    offset_ += bytes;
+    return (GLintptr)offset;
+  }
+};
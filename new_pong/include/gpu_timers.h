@@ -0,0 +1,239 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// GPU pass timers
+//
+// begin("name") and end() bracket a pass with GPU timestamp queries. Each
+// frame's queries come from its own pool, and a pool is only read back when
+// its frame comes round again, frames_in_flight frames later. By then the GPU
+// has long finished it. Results that are still not ready are dropped
+// rather than waited for. Every pass keeps a rolling average over its last
+// history frames.
+//
+// Timestamps (GL 3.3 / ARB_timer_query) let passes nest. With only
+// EXT_timer_query, GL_TIME_ELAPSED is used and nested passes are skipped.
+// Nothing is issued until enable() is called. Dynamic resolution enables
+// the timers without logging to read the newest frame time.
+//
+
+class gpu_timers {
+  enum {
+    frames_in_flight = 3,
+    max_queries = 64,     // per frame: two per pass with timestamps
+    max_passes = 16,
+    history = 64,
+  };
+
+  enum query_mode {
+    query_none,
+    query_timestamp,
+    query_elapsed,
+  };
+
+  struct pass {
+    const char *name;
+    double samples[history];
+    unsigned count;       // samples taken, up to history
+    unsigned next;        // where the next sample goes
+    double frame_ms;      // this frame's total while it is being read back
+  };
+
+  // one begin/end pair in a frame
+  struct record {
+    unsigned pass;
+    unsigned begin_query, end_query;
+  };
+
+  struct frame {
+    GLuint queries[max_queries];
+    unsigned num_queries;
+    std::vector<record> records;
+  };
+
+  frame frames_[frames_in_flight];
+  pass passes_[max_passes];
+  unsigned num_passes_;
+  unsigned frame_;
+  unsigned dropped_;
+  unsigned frames_read_;
+  std::vector<unsigned> open_;   // records begun but not ended
+  query_mode mode_;
+  bool requested_;
+  bool log_;
+  bool ready_;
+
+  unsigned find_pass(const char *name) {
+    for (unsigned i = 0; i != num_passes_; ++i) {
+      if (passes_[i].name == name || !strcmp(passes_[i].name, name)) return i;
+    }
+    if (num_passes_ == max_passes) return max_passes;
+    pass &p = passes_[num_passes_];
+    memset(&p, 0, sizeof(p));
+    p.name = name;
+    return num_passes_++;
+  }
+
+  void create() {
+    ready_ = true;
+    if (gl_version_at_least(3, 3) || gl_has_extension("GL_ARB_timer_query")) {
+      mode_ = query_timestamp;
+    } else if (gl_has_extension("GL_EXT_timer_query")) {
+      mode_ = query_elapsed;
+    } else {
+      printf("gpu timers: no timer queries on this driver\n");
+      return;
+    }
+    for (unsigned i = 0; i != frames_in_flight; ++i) {
+      glGenQueries(max_queries, frames_[i].queries);
+      frames_[i].num_queries = 0;
+    }
+  }
+
+  // collect the results of a frame issued frames_in_flight frames ago
+  void read_back(frame &f) {
+    for (unsigned i = 0; i != num_passes_; ++i) passes_[i].frame_ms = -1;
+    if (f.num_queries) {
+      GLuint available = 0;
+      glGetQueryObjectuiv(f.queries[f.num_queries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available) {
+        dropped_++;
+      } else if (frames_read_++ == 0) {
+        // the first frame also times the driver warming up: some report nonsense
+      } else {
+        for (size_t i = 0; i != f.records.size(); ++i) {
+          const record &r = f.records[i];
+          GLuint64 ns = 0;
+          if (mode_ == query_timestamp) {
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(f.queries[r.begin_query], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(f.queries[r.end_query], GL_QUERY_RESULT, &end);
+            ns = end - start;
+          } else {
+            glGetQueryObjectui64v(f.queries[r.begin_query], GL_QUERY_RESULT, &ns);
+          }
+          // a pass may run more than once in a frame: add them up
+          pass &p = passes_[r.pass];
+          p.frame_ms = (p.frame_ms < 0 ? 0 : p.frame_ms) + ns * 1e-6;
+        }
+        for (unsigned i = 0; i != num_passes_; ++i) {
+          pass &p = passes_[i];
+          if (p.frame_ms < 0) continue;
+          p.samples[p.next] = p.frame_ms;
+          p.next = (p.next + 1) % history;
+          p.count += p.count != history;
+        }
+      }
+    }
+    f.num_queries = 0;
+    f.records.clear();
+  }
+
+  gpu_timers() {
+    num_passes_ = 0;
+    frame_ = 0;
+    dropped_ = 0;
+    frames_read_ = 0;
+    mode_ = query_none;
+    requested_ = false;
+    log_ = false;
+    ready_ = false;
+  }
+public:
+  // start timing. The queries are made on the next frame, with a context.
+  void enable(bool log = true) {
+    requested_ = true;
+    log_ = log_ || log;
+  }
+  bool enabled() const { return requested_ && mode_ != query_none; }
+
+  // call at the start of every frame, before any pass
+  void begin_frame() {
+    if (!requested_) return;
+    if (!ready_) create();
+    if (mode_ == query_none) return;
+    frame_++;
+    read_back(frames_[frame_ % frames_in_flight]);
+    open_.clear();
+  }
+
+  // name must outlive the timers: a string literal
+  void begin(const char *name) {
+    if (!enabled()) return;
+    frame &f = frames_[frame_ % frames_in_flight];
+    if (mode_ == query_elapsed && !open_.empty()) {
+      // GL_TIME_ELAPSED queries can't nest
+      open_.push_back(~0u);
+      return;
+    }
+    unsigned p = find_pass(name);
+    if (p == max_passes || f.num_queries + 2 > max_queries) {
+      open_.push_back(~0u);
+      return;
+    }
+    record r = { p, f.num_queries, f.num_queries + 1 };
+    f.num_queries += mode_ == query_timestamp ? 2 : 1;
+    if (mode_ == query_timestamp) {
+      glQueryCounter(f.queries[r.begin_query], GL_TIMESTAMP);
+    } else {
+      glBeginQuery(GL_TIME_ELAPSED, f.queries[r.begin_query]);
+    }
+    open_.push_back((unsigned)f.records.size());
+    f.records.push_back(r);
+  }
+
+  void end() {
+    if (!enabled() || open_.empty()) return;
+    unsigned index = open_.back();
+    open_.pop_back();
+    if (index == ~0u) return;
+    frame &f = frames_[frame_ % frames_in_flight];
+    if (mode_ == query_timestamp) {
+      glQueryCounter(f.queries[f.records[index].end_query], GL_TIMESTAMP);
+    } else {
+      glEndQuery(GL_TIME_ELAPSED);
+    }
+  }
+
+  // rolling averages
+  unsigned num_passes() const { return num_passes_; }
+  const char *pass_name(unsigned i) const { return passes_[i].name; }
+
+  double average_ms(unsigned i) const {
+    const pass &p = passes_[i];
+    double total = 0;
+    for (unsigned s = 0; s != p.count; ++s) total += p.samples[s];
+    return p.count ? total / p.count : 0;
+  }
+
+  double average_ms(const char *name) const {
+    for (unsigned i = 0; i != num_passes_; ++i) {
+      if (!strcmp(passes_[i].name, name)) return average_ms(i);
+    }
+    return 0;
+  }
+
+  // the pass in the frame read back by this frame's begin_frame(), or -1 if none came in
+  double frame_ms(const char *name) const {
+    for (unsigned i = 0; i != num_passes_; ++i) {
+      if (!strcmp(passes_[i].name, name)) return passes_[i].frame_ms;
+    }
+    return -1;
+  }
+
+  // frames whose results were not ready in time
+  unsigned dropped() const { return dropped_; }
+
+  // one line: "gpu: frame 0.412ms, background 0.050ms, ..."
+  void dump(FILE *file = stdout) const {
+    if (!enabled() || !log_) return;
+    fprintf(file, "gpu:");
+    for (unsigned i = 0; i != num_passes_; ++i) {
+      fprintf(file, "%s %s %.3fms", i ? "," : "", passes_[i].name, average_ms(i));
+    }
+    fprintf(file, " (%u late frames dropped)\n", dropped_);
+  }
+
+  static gpu_timers &get() {
+    static gpu_timers the_timers;
+    return the_timers;
+  }
+};
@@ -0,0 +1,291 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// headless rendering
+//
+// Runs the game without a window, for machines with no display: an EGL
+// context with no surface (Mesa's llvmpipe is fine) renders every frame into
+// an FBO, or with --soft the software rasterizer draws it with no GL at all.
+// Each frame is timed up to glFinish, the last frame can be saved as a PNG
+// or compared with a golden image, and the run fails if it differs.
+//
+//   my_pong --headless 300 --png out.png
+//   my_pong --headless 300 --golden golden.png --tolerance 2
+//   my_pong --headless 1000 --soft --width 1920 --height 1080 --threads 8
+//   my_pong --headless 300 --core     in a GL 3.3 core profile context
+//
+// The EGL part is only built with PONG_HEADLESS defined (link with -lEGL):
+// "make headless" builds it on Linux and "make check" compares the scripted
+// runs with the images in golden/ in every backend.
+// Input is scripted and the serve is seeded so that every run is the same.
+//
+
+struct headless_options {
+  unsigned frames;
+  int width, height;
+  const char *png;
+  const char *golden;
+  int tolerance;        // largest per channel difference that still passes
+  unsigned dump_every;  // also save every n-th frame as frame_00000.png
+  bool software;        // draw with soft_rasterizer instead of GL
+  unsigned threads;     // ...on this many threads, 0 for every core
+  bool core;            // ask EGL for a GL 3.3 core profile context
+
+  headless_options() {
+    frames = 0;
+    width = height = 500;
+    png = golden = 0;
+    tolerance = 0;
+    dump_every = 0;
+    software = false;
+    threads = 0;
+    core = false;
+  }
+
+  // take one option from argv. returns the arguments used, or 0.
+  int parse(int argc, char **argv, int i) {
+    if (!strcmp(argv[i], "--soft")) {
+      software = true;
+      return 1;
+    }
+    if (!strcmp(argv[i], "--core")) {
+      core = true;
+      return 1;
+    }
+    if (i + 1 >= argc) return 0;
+    if (!strcmp(argv[i], "--headless")) frames = (unsigned)atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--png")) png = argv[i + 1];
+    else if (!strcmp(argv[i], "--golden")) golden = argv[i + 1];
+    else if (!strcmp(argv[i], "--tolerance")) tolerance = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--dump-every")) dump_every = (unsigned)atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--threads")) threads = (unsigned)atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--width")) width = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--height")) height = atoi(argv[i + 1]);
+    else return 0;
+    return 2;
+  }
+};
+
+// compare two images channel by channel
+struct image_diff {
+  unsigned bad_pixels;
+  int max_diff;
+
+  image_diff(const unsigned char *a, const unsigned char *b, size_t bytes, int tolerance) {
+    bad_pixels = 0;
+    max_diff = 0;
+    for (size_t i = 0; i + 4 <= bytes; i += 4) {
+      int worst = 0;
+      for (int c = 0; c != 4; ++c) {
+        int d = abs((int)a[i + c] - (int)b[i + c]);
+        worst = d > worst ? d : worst;
+      }
+      max_diff = worst > max_diff ? worst : max_diff;
+      bad_pixels += worst > tolerance;
+    }
+  }
+};
+
+// serve at once and sweep the bat up and down
+inline void headless_input(unsigned frame) {
+  bool up = frame % 40 < 20;
+  key_special_states[GLUT_KEY_UP] = up;
+  key_special_states[GLUT_KEY_DOWN] = !up;
+}
+
+inline void save_frame(unsigned frame, const unsigned char *pixels, int w, int h) {
+  char filename[32];
+  sprintf_s(filename, sizeof(filename), "frame_%05u.png", frame);
+  png_file::write(filename, pixels, w, h);
+}
+
+// save and check the last frame. returns the exit code for main.
+inline int finish_headless(const headless_options &options, const unsigned char *pixels) {
+  if (options.png && !png_file::write(options.png, pixels, options.width, options.height)) {
+    printf("can't write %s\n", options.png);
+    return 1;
+  }
+  if (options.golden) {
+    std::vector<unsigned char> golden;
+    int w, h;
+    if (!png_file::read(options.golden, golden, w, h)) {
+      printf("can't read golden image %s\n", options.golden);
+      return 1;
+    }
+    if (w != options.width || h != options.height) {
+      printf("golden image is %dx%d, frames are %dx%d\n", w, h, options.width, options.height);
+      return 1;
+    }
+    image_diff diff(pixels, &golden[0], golden.size(), options.tolerance);
+    printf("golden: %u pixels differ, max difference %d\n", diff.bad_pixels, diff.max_diff);
+    if (diff.bad_pixels) return 1;
+  }
+  return 0;
+}
+
+// the same run drawn by soft_rasterizer: no GL calls at all
+template <class Game> int run_software(const headless_options &options) {
+  unsigned char *texels = texture_manager::new_pixels("texture.tga", 0, 0, 256, 256);
+  if (!texels) {
+    printf("can't read texture.tga\n");
+    return 1;
+  }
+  soft_texture soft_background = { texels, 256, 256 };
+  soft_rasterizer raster;
+  raster.init(options.threads);
+  serve_seed = 1;
+  Game::reshape(options.width, options.height);
+
+  Game::key_down(' ', 0, 0);
+  frame_histogram timings;
+  for (unsigned frame = 0; frame != options.frames; ++frame) {
+    headless_input(frame);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Game::display_soft(raster, soft_background);
+    std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
+    timings.add(ms.count());
+
+    if (options.dump_every && frame % options.dump_every == 0) {
+      save_frame(frame, raster.pixels(), options.width, options.height);
+    }
+  }
+  printf("software rasterizer, %u threads\n", raster.num_threads());
+  timings.print();
+
+  int result = finish_headless(options, raster.pixels());
+  free(texels);
+  return result;
+}
+
+#ifdef PONG_HEADLESS
+// an OpenGL context with no window
+class headless_context {
+  EGLDisplay display_;
+  EGLContext context_;
+  EGLSurface surface_;
+public:
+  headless_context() {
+    display_ = EGL_NO_DISPLAY;
+    context_ = EGL_NO_CONTEXT;
+    surface_ = EGL_NO_SURFACE;
+  }
+
+  ~headless_context() {
+    if (display_ == EGL_NO_DISPLAY) return;
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (surface_ != EGL_NO_SURFACE) eglDestroySurface(display_, surface_);
+    if (context_ != EGL_NO_CONTEXT) eglDestroyContext(display_, context_);
+    eglTerminate(display_);
+  }
+
+  bool init(bool core) {
+    // Mesa's surfaceless platform needs no X server or GPU
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display) {
+      display_ = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (display_ == EGL_NO_DISPLAY) {
+      display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    EGLint major, minor;
+    if (display_ == EGL_NO_DISPLAY || !eglInitialize(display_, &major, &minor)) {
+      printf("headless: no EGL display\n");
+      return false;
+    }
+    eglBindAPI(EGL_OPENGL_API);
+
+    static const EGLint config_attribs[] = {
+      EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+      EGL_NONE
+    };
+    EGLConfig config;
+    EGLint num_configs = 0;
+    if (!eglChooseConfig(display_, config_attribs, &config, 1, &num_configs) || !num_configs) {
+      printf("headless: no EGL config\n");
+      return false;
+    }
+    static const EGLint core_attribs[] = {
+      EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+      EGL_NONE
+    };
+    context_ = eglCreateContext(display_, config, EGL_NO_CONTEXT, core ? core_attribs : NULL);
+    if (context_ == EGL_NO_CONTEXT) {
+      printf("headless: no GL context\n");
+      return false;
+    }
+
+    // drivers without surfaceless contexts get a tiny pbuffer
+    if (!eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, context_)) {
+      static const EGLint pbuffer_attribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+      surface_ = eglCreatePbufferSurface(display_, config, pbuffer_attribs);
+      if (!eglMakeCurrent(display_, surface_, surface_, context_)) {
+        printf("headless: can't make the context current\n");
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+// render a game offscreen on the GPU
+template <class Game> int run_gl(const headless_options &options) {
+  headless_context context;
+  offscreen_target target;
+  if (!context.init(options.core)) return 1;
+  gl_load_entry_points();
+  if (!target.init(options.width, options.height)) return 1;
+  headless = true;
+  serve_seed = 1;
+  frame_capture::get().wait_for_encoder(true);
+  background = texture_atlas::get().add("texture.tga", 0, 0, 256, 256);
+  Game::reshape(options.width, options.height);
+
+  Game::key_down(' ', 0, 0);
+  std::vector<unsigned char> pixels;
+  frame_histogram timings;
+  for (unsigned frame = 0; frame != options.frames; ++frame) {
+    headless_input(frame);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Game::display();
+    glFinish();
+    std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
+    timings.add(ms.count());
+
+    if (options.dump_every && frame % options.dump_every == 0) {
+      target.read(pixels);
+      save_frame(frame, &pixels[0], options.width, options.height);
+    }
+  }
+  timings.print();
+  frame_capture::get().finish();
+  render_stats &stats = render_stats::get();
+  printf(
+    "last frame: %u draw calls, %u quads, %u state calls (%u skipped)\n",
+    stats.draw_calls(), stats.quads(), stats.state_calls(), stats.skipped_calls()
+  );
+
+  gpu_timers::get().dump();
+
+  GLenum error = glGetError();
+  if (error != GL_NO_ERROR) {
+    printf("GL error %04x\n", error);
+    return 1;
+  }
+
+  target.read(pixels);
+  return finish_headless(options, &pixels[0]);
+}
+#else
+template <class Game> int run_gl(const headless_options &options) {
+  printf("built without PONG_HEADLESS: use --soft for headless runs\n");
+  return 1;
+}
+#endif
+
+// returns the exit code for main
+template <class Game> int run_headless(const headless_options &options) {
+  return options.software ? run_software<Game>(options) : run_gl<Game>(options);
+}
@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// instanced box renderer
+//
+// Every box is one 32 byte instance: center, half extents, x axis and an
+// RGBA8 color. A static unit quad is expanded into the box by the vertex
+// shader, so the whole render list is one glDrawArraysInstanced however many
+// boxes there are. Instances are written straight into a gpu_ring. Needs GL 3.3 (or ARB_instanced_arrays); use sprite_batch
+// where that is missing.
+//
+// The unit quad is pointed at once, in a vertex array object of the
+// renderer's own; each draw only points the instance attributes.
+//
+
+class instanced_boxes {
+public:
+  // 32 bytes per box
+  struct instance {
+    float cx, cy;
+    float hx, hy;
+    float ax, ay;
+    unsigned char color[4];
+    unsigned pad;
+
+    void set(const vec4 &center, const vec4 &half_extents, const vec4 &axis) {
+      cx = center[0]; cy = center[1];
+      hx = half_extents[0]; hy = half_extents[1];
+      ax = axis[0]; ay = axis[1];
+      pad = 0;
+    }
+  };
+
+private:
+  gpu_ring *ring_;
+  instance *instances_;
+  unsigned size_;
+  unsigned capacity_;
+
+  GLuint vertex_array_;     // 0 without vertex array objects
+  GLuint quad_buffer_;
+  shader shader_;
+  bool supported_;
+
+public:
+  instanced_boxes() {
+    ring_ = 0;
+    instances_ = 0;
+    size_ = capacity_ = 0;
+    vertex_array_ = 0;
+    supported_ = false;
+  }
+
+  // true if the driver can draw instances with per-instance attributes
+  static bool driver_supports_instancing() {
+    return gl_version_at_least(3, 3) || (gl_version_at_least(3, 1) && gl_has_extension("GL_ARB_instanced_arrays"));
+  }
+
+  void init(gpu_ring &ring) {
+    ring_ = &ring;
+    supported_ = driver_supports_instancing();
+    if (!supported_) return;
+
+    // the unit quad as a triangle fan
+    float corners[4*2] = { -1, -1,  1, -1,  1, 1,  -1, 1 };
+    gl_state &gl = gl_state::get();
+    glGenBuffers(1, &quad_buffer_);
+    gl.bind_buffer(GL_ARRAY_BUFFER, quad_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    if (gl_has_vertex_arrays()) {
+      glGenVertexArrays(1, &vertex_array_);
+      gl.bind_vertex_array(vertex_array_);
+      gl.attrib_pointer(attrib_pos, 2, GL_FLOAT, GL_FALSE, 2*sizeof(float), (void*)0);
+    }
+
+    shader_.init(
+      "attribute vec4 pos;"
+      "attribute vec4 box;"
+      "attribute vec2 axis;"
+      "attribute vec4 color;"
+      "varying vec4 color_;"
+      "void main() {"
+      "  vec2 x = axis * (box.z * pos.x);"
+      "  vec2 y = vec2(-axis.y, axis.x) * (box.w * pos.y);"
+      "  gl_Position = view_proj * vec4(box.xy + x + y, 0, 1);"
+      "  color_ = color;"
+      "}",
+
+      "varying vec4 color_;"
+      "void main() { gl_FragColor = color_; }"
+    );
+  }
+
+  bool supported() const { return supported_; }
+
+  // make room in the ring for up to max_boxes
+  void begin(unsigned max_boxes) {
+    instances_ = (instance*)ring_->reserve(max_boxes * sizeof(instance), sizeof(instance));
+    size_ = 0;
+    capacity_ = max_boxes;
+  }
+
+  unsigned size() const { return size_; }
+
+  void add(const vec4 &center, const vec4 &half_extents, const vec4 &color, const vec4 &axis) {
+    assert(size_ != capacity_);
+    instance &i = instances_[size_++];
+    i.set(center, half_extents, axis);
+    for (int c = 0; c != 4; ++c) {
+      i.color[c] = sprite_batch::to_byte(color[c]);
+    }
+  }
+
+  // draw every box added since begin() in one call
+  void draw() {
+    GLintptr offset = ring_->commit(size_ * sizeof(instance));
+    draw(ring_->buffer(), offset, size_);
+  }
+
+  // draw count instances that are already in a buffer, starting at offset
+  void draw(GLuint buffer, GLintptr offset, unsigned count) {
+    if (!count) return;
+
+    shader_.use();
+
+    gl_state &gl = gl_state::get();
+    GLuint mask = 1u << attrib_pos;
+    if (vertex_array_) {
+      gl.bind_vertex_array(vertex_array_);
+    } else {
+      gl.bind_buffer(GL_ARRAY_BUFFER, quad_buffer_);
+      gl.attrib_pointer(attrib_pos, 2, GL_FLOAT, GL_FALSE, 2*sizeof(float), (void*)0);
+    }
+
+    char *base = (char*)offset;
+    gl.bind_buffer(GL_ARRAY_BUFFER, buffer);
+    mask |= gl.attrib_pointer(attrib_box, 4, GL_FLOAT, GL_FALSE, sizeof(instance), base + offsetof(instance, cx), 1);
+    mask |= gl.attrib_pointer(attrib_axis, 2, GL_FLOAT, GL_FALSE, sizeof(instance), base + offsetof(instance, ax), 1);
+    mask |= gl.attrib_pointer(attrib_color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(instance), base + offsetof(instance, color), 1);
+    gl.enable_attribs(mask);
+
+    glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, count);
+    render_stats::get().draw_call(count);
+  }
+};
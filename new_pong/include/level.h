@@ -0,0 +1,353 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// binary level files
+//
+// A level is one flat file that is memory mapped and used in place: no
+// parsing, no copying. Every array is stored SoA and starts on a 16 byte
+// boundary so it can be walked directly (or with SIMD) from the mapping.
+//
+//   level_header
+//   float    brick_cx[num_bricks]
+//   float    brick_cy[num_bricks]
+//   float    brick_hx[num_bricks]
+//   float    brick_hy[num_bricks]
+//   unsigned brick_color[num_bricks]          RGBA8, red in the low byte
+//   level_obstacle obstacles[num_obstacles]
+//   float    path_x[num_path_points]
+//   float    path_y[num_path_points]
+//   unsigned cell_start[grid_w * grid_h + 1]  first entry of each cell in cell_bricks
+//   unsigned cell_bricks[num_cell_refs]       brick indices, cell by cell
+//
+// The broadphase grid is built by level_writer, so a ball only has to look
+// at the bricks in the few cells it touches.
+//
+
+// a moving obstacle that loops round a path of points
+struct level_obstacle {
+  unsigned first_point;
+  unsigned num_points;
+  float speed;          // distance per tick
+  float hx, hy;         // half extents
+  float spin;           // radians per tick
+  unsigned pad[2];
+};
+
+struct level_header {
+  enum { current_version = 1 };
+
+  char magic[4];        // "PLVL"
+  unsigned version;
+  unsigned file_size;
+
+  unsigned num_bricks;
+  unsigned num_obstacles;
+  unsigned num_path_points;
+
+  // broadphase grid
+  unsigned grid_w, grid_h;
+  unsigned num_cell_refs;
+  float grid_x, grid_y;             // bottom left corner
+  float cell_w, cell_h;
+
+  // byte offsets of the arrays from the start of the file
+  unsigned brick_cx, brick_cy, brick_hx, brick_hy, brick_color;
+  unsigned obstacles;
+  unsigned path_x, path_y;
+  unsigned cell_start, cell_bricks;
+};
+
+// floor(f) clamped to [lo, hi]. the clamp is done on the float, since
+// converting one that is out of range for an int is undefined. NaN gives lo.
+inline int clamp_floor(float f, int lo, int hi) {
+  f = floorf(f);
+  return f >= (float)hi ? hi : f > (float)lo ? (int)f : lo;
+}
+
+// a level mapped from disk (or held in memory)
+class level_file {
+  const unsigned char *data_;
+  size_t size_;
+  std::vector<unsigned char> memory_;
+
+  #ifdef WIN32
+    HANDLE file_;
+    HANDLE mapping_;
+  #endif
+
+  // true if count elements of size bytes at offset fit in the file
+  bool in_file(unsigned offset, size_t count, size_t bytes) const {
+    return (offset & 3) == 0 && offset <= size_ && count <= (size_ - offset) / bytes;
+  }
+
+  bool validate() {
+    if (size_ < sizeof(level_header)) return false;
+    const level_header &h = header();
+    size_t cells = (size_t)h.grid_w * h.grid_h + 1;
+    bool ok =
+      !memcmp(h.magic, "PLVL", 4) && h.version == level_header::current_version && h.file_size == size_ &&
+      in_file(h.brick_cx, h.num_bricks, sizeof(float)) &&
+      in_file(h.brick_cy, h.num_bricks, sizeof(float)) &&
+      in_file(h.brick_hx, h.num_bricks, sizeof(float)) &&
+      in_file(h.brick_hy, h.num_bricks, sizeof(float)) &&
+      in_file(h.brick_color, h.num_bricks, sizeof(unsigned)) &&
+      in_file(h.obstacles, h.num_obstacles, sizeof(level_obstacle)) &&
+      in_file(h.path_x, h.num_path_points, sizeof(float)) &&
+      in_file(h.path_y, h.num_path_points, sizeof(float)) &&
+      in_file(h.cell_start, cells, sizeof(unsigned)) &&
+      in_file(h.cell_bricks, h.num_cell_refs, sizeof(unsigned)) &&
+      (int)h.grid_w > 0 && (int)h.grid_h > 0 && h.cell_w > 0 && h.cell_h > 0 &&
+      isfinite(h.grid_x) && isfinite(h.grid_y) && isfinite(h.cell_w) && isfinite(h.cell_h)
+    ;
+    if (!ok) return false;
+
+    // the broadphase and the obstacle paths are walked without bounds
+    // checks, so every range and index in them must be good.
+    const level_obstacle *o = obstacles();
+    for (unsigned i = 0; i != h.num_obstacles; ++i) {
+      if (o[i].first_point > h.num_path_points || o[i].num_points > h.num_path_points - o[i].first_point) return false;
+    }
+    const unsigned *start = cell_start(), *refs = cell_bricks();
+    if (start[0] != 0 || start[cells - 1] != h.num_cell_refs) return false;
+    for (size_t c = 1; c != cells; ++c) {
+      if (start[c] < start[c - 1]) return false;
+    }
+    for (unsigned r = 0; r != h.num_cell_refs; ++r) {
+      if (refs[r] >= h.num_bricks) return false;
+    }
+    return true;
+  }
+
+  template <class T> const T *at(unsigned offset) const { return (const T*)(data_ + offset); }
+public:
+  level_file() {
+    data_ = 0;
+    size_ = 0;
+    #ifdef WIN32
+      file_ = INVALID_HANDLE_VALUE;
+      mapping_ = 0;
+    #endif
+  }
+
+  ~level_file() { close(); }
+
+  void close() {
+    #ifdef WIN32
+      if (data_ && memory_.empty()) UnmapViewOfFile(data_);
+      if (mapping_) CloseHandle(mapping_);
+      if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+      mapping_ = 0;
+      file_ = INVALID_HANDLE_VALUE;
+    #else
+      if (data_ && memory_.empty()) munmap((void*)data_, size_);
+    #endif
+    memory_.clear();
+    data_ = 0;
+    size_ = 0;
+  }
+
+  // map a level file read only. validation reads all of cell_start and
+  // cell_bricks, so those pages are touched at load; the rest only when used.
+  bool map(const char *filename) {
+    close();
+    #ifdef WIN32
+      file_ = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+      if (file_ == INVALID_HANDLE_VALUE) return false;
+      LARGE_INTEGER size;
+      GetFileSizeEx(file_, &size);
+      mapping_ = CreateFileMappingA(file_, 0, PAGE_READONLY, 0, 0, 0);
+      data_ = mapping_ ? (const unsigned char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0) : 0;
+      size_ = (size_t)size.QuadPart;
+    #else
+      int fd = open(filename, O_RDONLY);
+      if (fd < 0) return false;
+      struct stat st;
+      fstat(fd, &st);
+      size_ = (size_t)st.st_size;
+      void *p = size_ ? mmap(0, size_, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+      ::close(fd);
+      data_ = p == MAP_FAILED ? 0 : (const unsigned char*)p;
+    #endif
+    if (!data_ || !validate()) {
+      printf("%s is not a valid level\n", filename);
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  // use a level image built in memory, eg. by level_writer
+  bool use_memory(std::vector<unsigned char> &image) {
+    close();
+    memory_.swap(image);
+    data_ = memory_.empty() ? 0 : &memory_[0];
+    size_ = memory_.size();
+    if (!data_ || !validate()) {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  bool loaded() const { return data_ != 0; }
+
+  const level_header &header() const { return *at<level_header>(0); }
+  unsigned num_bricks() const { return header().num_bricks; }
+  unsigned num_obstacles() const { return header().num_obstacles; }
+
+  const float *brick_cx() const { return at<float>(header().brick_cx); }
+  const float *brick_cy() const { return at<float>(header().brick_cy); }
+  const float *brick_hx() const { return at<float>(header().brick_hx); }
+  const float *brick_hy() const { return at<float>(header().brick_hy); }
+  const unsigned *brick_color() const { return at<unsigned>(header().brick_color); }
+  const level_obstacle *obstacles() const { return at<level_obstacle>(header().obstacles); }
+  const float *path_x() const { return at<float>(header().path_x); }
+  const float *path_y() const { return at<float>(header().path_y); }
+  const unsigned *cell_start() const { return at<unsigned>(header().cell_start); }
+  const unsigned *cell_bricks() const { return at<unsigned>(header().cell_bricks); }
+
+  // cell range covered by a box, clamped to the grid. a box outside the
+  // grid (or NaN) gives an empty range.
+  void cell_range(float x0, float y0, float x1, float y1, int &cx0, int &cy0, int &cx1, int &cy1) const {
+    const level_header &h = header();
+    cx0 = clamp_floor((x0 - h.grid_x) / h.cell_w, 0, (int)h.grid_w);
+    cy0 = clamp_floor((y0 - h.grid_y) / h.cell_h, 0, (int)h.grid_h);
+    cx1 = clamp_floor((x1 - h.grid_x) / h.cell_w, -1, (int)h.grid_w - 1);
+    cy1 = clamp_floor((y1 - h.grid_y) / h.cell_h, -1, (int)h.grid_h - 1);
+  }
+
+  // the level the game is playing
+  static level_file &get() {
+    static level_file the_level;
+    return the_level;
+  }
+};
+
+// builds level images for level_file
+class level_writer {
+  std::vector<float> cx_, cy_, hx_, hy_;
+  std::vector<unsigned> color_;
+  std::vector<level_obstacle> obstacles_;
+  std::vector<float> px_, py_;
+
+  static unsigned align16(size_t offset) { return (unsigned)((offset + 15) & ~(size_t)15); }
+
+  template <class T> static void put(std::vector<unsigned char> &image, unsigned offset, const std::vector<T> &v) {
+    if (!v.empty()) memcpy(&image[offset], &v[0], v.size() * sizeof(T));
+  }
+public:
+  void add_brick(float cx, float cy, float hx, float hy, unsigned rgba = 0xffffffff) {
+    cx_.push_back(cx);
+    cy_.push_back(cy);
+    hx_.push_back(hx);
+    hy_.push_back(hy);
+    color_.push_back(rgba);
+  }
+
+  // start a new obstacle, follow with add_path_point calls
+  void add_obstacle(float hx, float hy, float speed, float spin = 0) {
+    level_obstacle o = { (unsigned)px_.size(), 0, speed, hx, hy, spin, { 0, 0 } };
+    obstacles_.push_back(o);
+  }
+
+  void add_path_point(float x, float y) {
+    assert(!obstacles_.empty());
+    px_.push_back(x);
+    py_.push_back(y);
+    obstacles_.back().num_points++;
+  }
+
+  // lay out the file and build the broadphase grid
+  std::vector<unsigned char> build() const {
+    level_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "PLVL", 4);
+    h.version = level_header::current_version;
+    h.num_bricks = (unsigned)cx_.size();
+    h.num_obstacles = (unsigned)obstacles_.size();
+    h.num_path_points = (unsigned)px_.size();
+
+    // grid bounds: the court, grown to cover every brick
+    float x0 = -1, y0 = -1, x1 = 1, y1 = 1;
+    for (unsigned i = 0; i != h.num_bricks; ++i) {
+      x0 = cx_[i] - hx_[i] < x0 ? cx_[i] - hx_[i] : x0;
+      y0 = cy_[i] - hy_[i] < y0 ? cy_[i] - hy_[i] : y0;
+      x1 = cx_[i] + hx_[i] > x1 ? cx_[i] + hx_[i] : x1;
+      y1 = cy_[i] + hy_[i] > y1 ? cy_[i] + hy_[i] : y1;
+    }
+
+    // aim for a few bricks per cell
+    unsigned side = (unsigned)sqrtf(h.num_bricks / 4.0f);
+    side = side < 1 ? 1 : side > 4096 ? 4096 : side;
+    h.grid_w = h.grid_h = side;
+    h.grid_x = x0;
+    h.grid_y = y0;
+    h.cell_w = (x1 - x0) / side;
+    h.cell_h = (y1 - y0) / side;
+
+    // count the bricks touching each cell, then fill the cells in order
+    size_t cells = (size_t)side * side;
+    std::vector<unsigned> starts(cells + 1, 0);
+    std::vector<unsigned> refs;
+    std::vector<unsigned> fill;
+    for (int pass = 0; pass != 2; ++pass) {
+      for (unsigned i = 0; i != h.num_bricks; ++i) {
+        int gx0 = (int)((cx_[i] - hx_[i] - x0) / h.cell_w), gx1 = (int)((cx_[i] + hx_[i] - x0) / h.cell_w);
+        int gy0 = (int)((cy_[i] - hy_[i] - y0) / h.cell_h), gy1 = (int)((cy_[i] + hy_[i] - y0) / h.cell_h);
+        gx1 = gx1 >= (int)side ? side - 1 : gx1;
+        gy1 = gy1 >= (int)side ? side - 1 : gy1;
+        for (int gy = gy0; gy <= gy1; ++gy) {
+          for (int gx = gx0; gx <= gx1; ++gx) {
+            if (pass == 0) {
+              starts[gy * side + gx + 1]++;
+            } else {
+              refs[fill[gy * side + gx]++] = i;
+            }
+          }
+        }
+      }
+      if (pass == 0) {
+        for (size_t c = 0; c != cells; ++c) starts[c + 1] += starts[c];
+        h.num_cell_refs = starts[cells];
+        refs.resize(h.num_cell_refs);
+        fill.assign(starts.begin(), starts.end() - 1);
+      }
+    }
+
+    // lay out the arrays
+    size_t offset = align16(sizeof(level_header));
+    h.brick_cx = (unsigned)offset; offset = align16(offset + h.num_bricks * sizeof(float));
+    h.brick_cy = (unsigned)offset; offset = align16(offset + h.num_bricks * sizeof(float));
+    h.brick_hx = (unsigned)offset; offset = align16(offset + h.num_bricks * sizeof(float));
+    h.brick_hy = (unsigned)offset; offset = align16(offset + h.num_bricks * sizeof(float));
+    h.brick_color = (unsigned)offset; offset = align16(offset + h.num_bricks * sizeof(unsigned));
+    h.obstacles = (unsigned)offset; offset = align16(offset + h.num_obstacles * sizeof(level_obstacle));
+    h.path_x = (unsigned)offset; offset = align16(offset + h.num_path_points * sizeof(float));
+    h.path_y = (unsigned)offset; offset = align16(offset + h.num_path_points * sizeof(float));
+    h.cell_start = (unsigned)offset; offset = align16(offset + (cells + 1) * sizeof(unsigned));
+    h.cell_bricks = (unsigned)offset; offset = align16(offset + h.num_cell_refs * sizeof(unsigned));
+    h.file_size = (unsigned)offset;
+
+    std::vector<unsigned char> image(offset, 0);
+    memcpy(&image[0], &h, sizeof(h));
+    put(image, h.brick_cx, cx_);
+    put(image, h.brick_cy, cy_);
+    put(image, h.brick_hx, hx_);
+    put(image, h.brick_hy, hy_);
+    put(image, h.brick_color, color_);
+    put(image, h.obstacles, obstacles_);
+    put(image, h.path_x, px_);
+    put(image, h.path_y, py_);
+    put(image, h.cell_start, starts);
+    put(image, h.cell_bricks, refs);
+    return image;
+  }
+
+  bool write(const char *filename) const {
+    std::vector<unsigned char> image = build();
+    FILE *out = fopen(filename, "wb");
+    if (!out) return false;
+    size_t written = fwrite(&image[0], 1, image.size(), out);
+    fclose(out);
+    return written == image.size();
+  }
+};
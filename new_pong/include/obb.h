@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// oriented bounding boxes
+//
+// obb_set keeps rotated boxes in SoA arrays padded to groups of four so that
+// one SSE pass runs the separating axis test of a ball's AABB against four
+// boxes at once. Only boxes that actually overlap leave the SIMD loop.
+//
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+  #define OBB_USE_SSE 1
+#endif
+
+class obb_set {
+  enum { lanes = 4 };
+
+  // center, unit x axis of the box, half extents
+  std::vector<float> cx_, cy_, ux_, uy_, hx_, hy_;
+  std::vector<entity_id> ids_;
+  unsigned size_;
+
+  // the four axes of the test for one box: world x, world y, box x, box y.
+  // d is the box center minus the ball center.
+  static void resolve(
+    float dx, float dy, float ux, float uy,
+    float pen_x, float pen_y, float pen_u, float pen_v,
+    float &nx, float &ny, float &depth
+  ) {
+    // push the ball out along the axis it is least deep in, away from the box
+    float du = dx * ux + dy * uy;
+    float dv = dy * ux - dx * uy;
+    nx = dx > 0 ? -1.0f : 1.0f; ny = 0; depth = pen_x;
+    if (pen_y < depth) { nx = 0; ny = dy > 0 ? -1.0f : 1.0f; depth = pen_y; }
+    if (pen_u < depth) { float s = du > 0 ? -1.0f : 1.0f; nx = ux * s; ny = uy * s; depth = pen_u; }
+    if (pen_v < depth) { float s = dv > 0 ? -1.0f : 1.0f; nx = -uy * s; ny = ux * s; depth = pen_v; }
+  }
+public:
+  obb_set() { size_ = 0; }
+
+  void clear() {
+    cx_.clear(); cy_.clear(); ux_.clear(); uy_.clear(); hx_.clear(); hy_.clear();
+    ids_.clear();
+    size_ = 0;
+  }
+
+  // axis is the box's x axis in world space (unit length)
+  void push(entity_id id, const vec4 &center, const vec4 &half_extents, const vec4 &axis) {
+    cx_.push_back(center[0]); cy_.push_back(center[1]);
+    ux_.push_back(axis[0]); uy_.push_back(axis[1]);
+    hx_.push_back(half_extents[0]); hy_.push_back(half_extents[1]);
+    ids_.push_back(id);
+    size_++;
+  }
+
+  // pad the arrays to a whole number of groups with boxes nothing can touch
+  void finish() {
+    while (cx_.size() % lanes) {
+      cx_.push_back(1e30f); cy_.push_back(1e30f);
+      ux_.push_back(1); uy_.push_back(0);
+      hx_.push_back(0); hy_.push_back(0);
+    }
+  }
+
+  unsigned size() const { return size_; }
+  entity_id id(unsigned i) const { return ids_[i]; }
+
+  // call f(index, nx, ny, depth) for every box the ball's AABB overlaps.
+  // (nx, ny) is the unit direction that pushes the ball out by depth.
+  template <class F> void overlaps(const vec4 &ball_pos, const vec4 &ball_half, F f) const {
+    unsigned padded = (unsigned)cx_.size();
+    if (!padded) return;
+    const float *cx = &cx_[0], *cy = &cy_[0], *ux = &ux_[0], *uy = &uy_[0], *hx = &hx_[0], *hy = &hy_[0];
+
+    #if OBB_USE_SSE
+      __m128 bx = _mm_set1_ps(ball_pos[0]), by = _mm_set1_ps(ball_pos[1]);
+      __m128 bw = _mm_set1_ps(ball_half[0]), bh = _mm_set1_ps(ball_half[1]);
+      __m128 sign = _mm_set1_ps(-0.0f);
+      __m128 zero = _mm_setzero_ps();
+
+      for (unsigned g = 0; g != padded; g += lanes) {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(cx + g), bx);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(cy + g), by);
+        __m128 vux = _mm_loadu_ps(ux + g), vuy = _mm_loadu_ps(uy + g);
+        __m128 vhx = _mm_loadu_ps(hx + g), vhy = _mm_loadu_ps(hy + g);
+        __m128 aux = _mm_andnot_ps(sign, vux), auy = _mm_andnot_ps(sign, vuy);
+
+        // box radius on world x and y: the box's y axis is (-uy, ux)
+        __m128 pen_x = _mm_sub_ps(_mm_add_ps(bw, _mm_add_ps(_mm_mul_ps(vhx, aux), _mm_mul_ps(vhy, auy))), _mm_andnot_ps(sign, dx));
+        __m128 pen_y = _mm_sub_ps(_mm_add_ps(bh, _mm_add_ps(_mm_mul_ps(vhx, auy), _mm_mul_ps(vhy, aux))), _mm_andnot_ps(sign, dy));
+
+        // ball radius on the box's own axes
+        __m128 du = _mm_add_ps(_mm_mul_ps(dx, vux), _mm_mul_ps(dy, vuy));
+        __m128 dv = _mm_sub_ps(_mm_mul_ps(dy, vux), _mm_mul_ps(dx, vuy));
+        __m128 pen_u = _mm_sub_ps(_mm_add_ps(vhx, _mm_add_ps(_mm_mul_ps(bw, aux), _mm_mul_ps(bh, auy))), _mm_andnot_ps(sign, du));
+        __m128 pen_v = _mm_sub_ps(_mm_add_ps(vhy, _mm_add_ps(_mm_mul_ps(bw, auy), _mm_mul_ps(bh, aux))), _mm_andnot_ps(sign, dv));
+
+        // separated if any axis has no overlap
+        __m128 hit = _mm_and_ps(
+          _mm_and_ps(_mm_cmpgt_ps(pen_x, zero), _mm_cmpgt_ps(pen_y, zero)),
+          _mm_and_ps(_mm_cmpgt_ps(pen_u, zero), _mm_cmpgt_ps(pen_v, zero))
+        );
+        int mask = _mm_movemask_ps(hit);
+        if (!mask) continue;
+
+        float px[lanes], py[lanes], pu[lanes], pv[lanes], ddx[lanes], ddy[lanes];
+        _mm_storeu_ps(px, pen_x); _mm_storeu_ps(py, pen_y);
+        _mm_storeu_ps(pu, pen_u); _mm_storeu_ps(pv, pen_v);
+        _mm_storeu_ps(ddx, dx); _mm_storeu_ps(ddy, dy);
+        for (int l = 0; l != lanes; ++l) {
+          if (mask & (1 << l)) {
+            float nx, ny, depth;
+            resolve(ddx[l], ddy[l], ux[g + l], uy[g + l], px[l], py[l], pu[l], pv[l], nx, ny, depth);
+            f(g + l, nx, ny, depth);
+          }
+        }
+      }
+    #else
+      for (unsigned i = 0; i != size_; ++i) {
+        float dx = cx[i] - ball_pos[0], dy = cy[i] - ball_pos[1];
+        float aux = fabsf(ux[i]), auy = fabsf(uy[i]);
+        float pen_x = ball_half[0] + hx[i] * aux + hy[i] * auy - fabsf(dx);
+        float pen_y = ball_half[1] + hx[i] * auy + hy[i] * aux - fabsf(dy);
+        float pen_u = hx[i] + ball_half[0] * aux + ball_half[1] * auy - fabsf(dx * ux[i] + dy * uy[i]);
+        float pen_v = hy[i] + ball_half[0] * auy + ball_half[1] * aux - fabsf(dy * ux[i] - dx * uy[i]);
+        if (pen_x > 0 && pen_y > 0 && pen_u > 0 && pen_v > 0) {
+          float nx, ny, depth;
+          resolve(dx, dy, ux[i], uy[i], pen_x, pen_y, pen_u, pen_v, nx, ny, depth);
+          f(i, nx, ny, depth);
+        }
+      }
+    #endif
+  }
+};
@@ -0,0 +1,113 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// offscreen render targets
+//
+// An FBO with a depth renderbuffer and a color renderbuffer, or a color
+// texture that can be drawn from. Headless runs draw every frame into one,
+// and the render graph pools them for passes that draw into textures, like
+// the reduced resolution scene that is drawn up to the window as a single
+// filtered sprite. The storage only grows: a smaller size reuses it and
+// draws into its bottom left corner.
+//
+
+class offscreen_target {
+  GLuint framebuffer_;
+  GLuint color_;        // a renderbuffer...
+  GLuint texture_;      // ...or a texture
+  GLuint depth_;
+  int width_, height_;
+
+  void allocate() {
+    if (texture_) {
+      gl_state::get().bind_texture(0, texture_);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width_, height_, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    } else {
+      glBindRenderbuffer(GL_RENDERBUFFER, color_);
+      glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width_, height_);
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width_, height_);
+  }
+public:
+  offscreen_target() {
+    framebuffer_ = color_ = texture_ = depth_ = 0;
+    width_ = height_ = 0;
+  }
+
+  // leaves the target bound. a texture target is sampled with a linear filter.
+  bool init(int w, int h, bool as_texture = false) {
+    width_ = w;
+    height_ = h;
+    glGenFramebuffers(1, &framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    if (as_texture) {
+      glGenTextures(1, &texture_);
+      gl_state::get().bind_texture(0, texture_);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    } else {
+      glGenRenderbuffers(1, &color_);
+    }
+    glGenRenderbuffers(1, &depth_);
+    allocate();
+    if (texture_) {
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_, 0);
+    } else {
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_);
+    }
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_);
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  }
+
+  // make room for at least w by h
+  void reserve(int w, int h) {
+    if (w <= width_ && h <= height_) return;
+    width_ = w > width_ ? w : width_;
+    height_ = h > height_ ? h : height_;
+    allocate();
+  }
+
+  // give the storage back to GL
+  void destroy() {
+    if (!framebuffer_) return;
+    glDeleteFramebuffers(1, &framebuffer_);
+    if (texture_) gl_state::get().delete_texture(texture_);
+    if (color_) glDeleteRenderbuffers(1, &color_);
+    glDeleteRenderbuffers(1, &depth_);
+    framebuffer_ = color_ = texture_ = depth_ = 0;
+    width_ = height_ = 0;
+  }
+
+  void bind() { glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_); }
+  bool ready() const { return framebuffer_ != 0; }
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+
+  // RGBA8 color and 24 bit depth, which drivers keep in 32 bits
+  size_t bytes() const { return (size_t)width_ * height_ * 8; }
+
+  // the w by h corner of a texture target, to draw as a sprite
+  atlas_region corner(int w, int h) const {
+    atlas_region region = { texture_, 0, 0, (float)w / width_, (float)h / height_ };
+    return region;
+  }
+
+  // the pixels, top row first
+  void read(std::vector<unsigned char> &rgba) {
+    size_t row = (size_t)width_ * 4;
+    rgba.resize(row * height_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, &rgba[0]);
+    std::vector<unsigned char> flip(row);
+    for (int y = 0; y < height_ / 2; ++y) {
+      unsigned char *a = &rgba[y * row], *b = &rgba[(height_ - 1 - y) * row];
+      memcpy(&flip[0], a, row);
+      memcpy(a, b, row);
+      memcpy(b, &flip[0], row);
+    }
+  }
+};
@@ -0,0 +1,315 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// png files
+//
+// Just enough PNG for frame dumps and golden images: 8 bit RGBA, no row
+// filters, so that no zlib is needed. The pixels are deflated with the fixed
+// Huffman codes, matching each byte only against the pixel before it and the
+// one above it; frames are mostly flat color, so that is most of the gain.
+// The reader takes back what the writer produces (fixed or stored blocks, no
+// row filters), so golden images should be made with --png rather than an
+// image editor.
+//
+
+class png_file {
+  static unsigned crc(unsigned c, const unsigned char *bytes, size_t size) {
+    static unsigned table[256];
+    if (!table[1]) {
+      for (unsigned n = 0; n != 256; ++n) {
+        unsigned k = n;
+        for (int i = 0; i != 8; ++i) k = k & 1 ? 0xedb88320 ^ (k >> 1) : k >> 1;
+        table[n] = k;
+      }
+    }
+    for (size_t i = 0; i != size; ++i) {
+      c = table[(c ^ bytes[i]) & 0xff] ^ (c >> 8);
+    }
+    return c;
+  }
+
+  static void put_be32(std::vector<unsigned char> &out, unsigned value) {
+    out.push_back((unsigned char)(value >> 24));
+    out.push_back((unsigned char)(value >> 16));
+    out.push_back((unsigned char)(value >> 8));
+    out.push_back((unsigned char)value);
+  }
+
+  static unsigned get_be32(const unsigned char *p) {
+    return (unsigned)p[0] << 24 | (unsigned)p[1] << 16 | (unsigned)p[2] << 8 | p[3];
+  }
+
+  // deflate's length codes (257 on) and distance codes: the first value of
+  // each and how many extra bits follow it
+  struct code_table {
+    unsigned base[30], extra[30];
+
+    code_table(bool distance) {
+      for (unsigned i = 0, value = distance ? 1 : 3; i != 30; ++i) {
+        extra[i] = distance ? (i < 4 ? 0 : i / 2 - 1) : (i < 8 ? 0 : i / 4 - 1);
+        base[i] = value;
+        value += 1u << extra[i];
+      }
+      if (!distance) {
+        base[28] = 258;
+        extra[28] = 0;
+      }
+    }
+  };
+
+  static const code_table &lengths() { static const code_table t(false); return t; }
+  static const code_table &distances() { static const code_table t(true); return t; }
+
+  // deflate packs bits from the bottom of each byte, huffman codes top bit first
+  struct bit_writer {
+    std::vector<unsigned char> &out;
+    unsigned bits, count;
+
+    bit_writer(std::vector<unsigned char> &out) : out(out), bits(0), count(0) {}
+
+    void put(unsigned value, unsigned n) {
+      bits |= value << count;
+      for (count += n; count >= 8; count -= 8) {
+        out.push_back((unsigned char)bits);
+        bits >>= 8;
+      }
+    }
+
+    void put_code(unsigned code, unsigned n) {
+      while (n--) put(code >> n & 1, 1);
+    }
+
+    // a symbol of the fixed literal/length code
+    void put_symbol(unsigned s) {
+      if (s < 144) put_code(0x30 + s, 8);
+      else if (s < 256) put_code(0x190 + s - 144, 9);
+      else if (s < 280) put_code(s - 256, 7);
+      else put_code(0xc0 + s - 280, 8);
+    }
+
+    void flush() {
+      if (count) out.push_back((unsigned char)bits);
+      bits = count = 0;
+    }
+  };
+
+  struct bit_reader {
+    const std::vector<unsigned char> &in;
+    size_t pos;
+    unsigned bit;
+    bool over;        // read past the end
+
+    bit_reader(const std::vector<unsigned char> &in, size_t pos) : in(in), pos(pos), bit(0), over(false) {}
+
+    unsigned get(unsigned n) {
+      unsigned value = 0;
+      for (unsigned i = 0; i != n; ++i) {
+        if (pos >= in.size()) {
+          over = true;
+          return 0;
+        }
+        value |= (in[pos] >> bit & 1) << i;
+        if (++bit == 8) {
+          bit = 0;
+          pos++;
+        }
+      }
+      return value;
+    }
+
+    unsigned get_code(unsigned n) {
+      unsigned code = 0;
+      while (n--) code = code << 1 | get(1);
+      return code;
+    }
+
+    // a symbol of the fixed literal/length code
+    unsigned get_symbol() {
+      unsigned code = get_code(7);
+      if (code < 0x18) return 256 + code;
+      code = code << 1 | get(1);
+      if (code < 0xc0) return code - 0x30;
+      if (code < 0xc8) return 280 + code - 0xc0;
+      return 144 + (code << 1 | get(1)) - 0x190;
+    }
+
+    void align() {
+      if (bit) {
+        bit = 0;
+        pos++;
+      }
+    }
+  };
+
+  // one fixed huffman block. each byte is matched against the same byte of
+  // the previous pixel and of the row above.
+  static void deflate(std::vector<unsigned char> &z, const std::vector<unsigned char> &raw, size_t row_bytes) {
+    const code_table &lt = lengths(), &dt = distances();
+    bit_writer out(z);
+    out.put(1, 1);
+    out.put(1, 2);
+    size_t n = raw.size(), candidates[2] = { 4, row_bytes };
+    for (size_t i = 0; i != n; ) {
+      size_t best = 0, best_dist = 0;
+      for (int c = 0; c != 2; ++c) {
+        size_t d = candidates[c], len = 0;
+        if (d > i || d > 32768) continue;
+        while (len != 258 && i + len != n && raw[i + len] == raw[i + len - d]) len++;
+        if (len > best) {
+          best = len;
+          best_dist = d;
+        }
+      }
+      if (best < 3) {
+        out.put_symbol(raw[i++]);
+        continue;
+      }
+      unsigned l = 28, d = 29;
+      while (lt.base[l] > best) l--;
+      while (dt.base[d] > best_dist) d--;
+      out.put_symbol(257 + l);
+      out.put((unsigned)best - lt.base[l], lt.extra[l]);
+      out.put_code(d, 5);
+      out.put((unsigned)best_dist - dt.base[d], dt.extra[d]);
+      i += best;
+    }
+    out.put_symbol(256);
+    out.flush();
+  }
+
+  // stored and fixed huffman blocks into raw, which must come to size bytes
+  static bool inflate(std::vector<unsigned char> &raw, const std::vector<unsigned char> &z, size_t size) {
+    const code_table &lt = lengths(), &dt = distances();
+    bit_reader in(z, 2);
+    raw.reserve(size);
+    for (bool last = false; !last; ) {
+      last = in.get(1) != 0;
+      unsigned type = in.get(2);
+      if (type == 0) {
+        in.align();
+        if (in.pos + 4 > z.size()) return false;
+        size_t len = z[in.pos] | z[in.pos + 1] << 8;
+        in.pos += 4;
+        if (in.pos + len > z.size() || raw.size() + len > size) return false;
+        raw.insert(raw.end(), z.begin() + in.pos, z.begin() + in.pos + len);
+        in.pos += len;
+      } else if (type == 1) {
+        for (;;) {
+          unsigned s = in.get_symbol();
+          if (in.over) return false;
+          if (s == 256) break;
+          if (s < 256) {
+            if (raw.size() == size) return false;
+            raw.push_back((unsigned char)s);
+            continue;
+          }
+          if (s - 257 >= 29) return false;
+          size_t len = lt.base[s - 257] + in.get(lt.extra[s - 257]);
+          unsigned d = in.get_code(5);
+          if (d >= 30) return false;
+          size_t dist = dt.base[d] + in.get(dt.extra[d]);
+          if (in.over || dist > raw.size() || raw.size() + len > size) return false;
+          for (size_t i = 0; i != len; ++i) {
+            unsigned char c = raw[raw.size() - dist];
+            raw.push_back(c);
+          }
+        }
+      } else {
+        return false;
+      }
+      if (in.over) return false;
+    }
+    return raw.size() == size;
+  }
+
+  // length, type, data, crc of type and data
+  static void put_chunk(std::vector<unsigned char> &out, const char *type, const unsigned char *data, size_t size) {
+    put_be32(out, (unsigned)size);
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    put_be32(out, crc(0xffffffff, &out[start], size + 4) ^ 0xffffffff);
+  }
+
+public:
+  // rgba is w * h pixels, top row first
+  static bool write(const char *filename, const unsigned char *rgba, int w, int h) {
+    // every row starts with filter type 0
+    size_t row_bytes = (size_t)w * 4 + 1;
+    std::vector<unsigned char> raw(row_bytes * h);
+    for (int y = 0; y != h; ++y) {
+      raw[y * row_bytes] = 0;
+      memcpy(&raw[y * row_bytes + 1], rgba + (size_t)y * w * 4, w * 4);
+    }
+
+    // a zlib stream of one fixed huffman block
+    std::vector<unsigned char> z;
+    z.push_back(0x78); z.push_back(0x01);
+    deflate(z, raw, row_bytes);
+    unsigned a = 1, b = 0;
+    for (size_t i = 0; i != raw.size(); ++i) {
+      a = (a + raw[i]) % 65521;
+      b = (b + a) % 65521;
+    }
+    put_be32(z, b << 16 | a);
+
+    std::vector<unsigned char> out;
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    out.insert(out.end(), signature, signature + 8);
+    unsigned char header[13] = { 0 };
+    header[0] = (unsigned char)(w >> 24); header[1] = (unsigned char)(w >> 16);
+    header[2] = (unsigned char)(w >> 8); header[3] = (unsigned char)w;
+    header[4] = (unsigned char)(h >> 24); header[5] = (unsigned char)(h >> 16);
+    header[6] = (unsigned char)(h >> 8); header[7] = (unsigned char)h;
+    header[8] = 8; header[9] = 6;   // 8 bits, RGBA
+    put_chunk(out, "IHDR", header, sizeof(header));
+    put_chunk(out, "IDAT", &z[0], z.size());
+    put_chunk(out, "IEND", 0, 0);
+
+    FILE *file = fopen(filename, "wb");
+    if (!file) return false;
+    bool ok = fwrite(&out[0], 1, out.size(), file) == out.size();
+    return fclose(file) == 0 && ok;
+  }
+
+  // read a png made by write() into rgba. false if it is missing or not one of ours.
+  static bool read(const char *filename, std::vector<unsigned char> &rgba, int &w, int &h) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) return false;
+    std::vector<unsigned char> in;
+    unsigned char buffer[4096];
+    for (size_t n; (n = fread(buffer, 1, sizeof(buffer), file)) != 0; ) {
+      in.insert(in.end(), buffer, buffer + n);
+    }
+    fclose(file);
+
+    // collect the IDAT chunks
+    if (in.size() < 8 || memcmp(&in[1], "PNG", 3)) return false;
+    std::vector<unsigned char> z;
+    w = h = 0;
+    for (size_t pos = 8; pos + 12 <= in.size(); ) {
+      size_t len = get_be32(&in[pos]);
+      const unsigned char *type = &in[pos + 4], *data = &in[pos + 8];
+      if (pos + 12 + len > in.size()) return false;
+      if (!memcmp(type, "IHDR", 4)) {
+        if (len != 13 || data[8] != 8 || data[9] != 6 || data[12] != 0) return false;
+        w = (int)get_be32(data);
+        h = (int)get_be32(data + 4);
+      } else if (!memcmp(type, "IDAT", 4)) {
+        z.insert(z.end(), data, data + len);
+      }
+      pos += 12 + len;
+    }
+
+    if (w <= 0 || h <= 0 || w > 32768 || h > 32768) return false;
+    size_t row_bytes = (size_t)w * 4 + 1;
+    std::vector<unsigned char> raw;
+    if (!inflate(raw, z, row_bytes * h)) return false;
+
+    rgba.resize((size_t)w * h * 4);
+    for (int y = 0; y != h; ++y) {
+      if (raw[y * row_bytes] != 0) return false;
+      memcpy(&rgba[(size_t)y * w * 4], &raw[y * row_bytes + 1], w * 4);
+    }
+    return true;
+  }
+};
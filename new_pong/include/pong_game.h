@@ -0,0 +1,681 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// the game core, shared by every mode
+//
+// Rules supplies the scoring, obstacle, bricks, players and court policies
+// (see rules.h). Each instantiation is its own singleton with its own
+// GLUT callbacks.
+//
+// With a window the simulation runs on its own thread at its own tick rate,
+// and the GLUT thread, which owns the GL context, only draws. After each
+// tick the simulation publishes a frame_snapshot through a triple buffer
+// and the renderer draws the newest one; key presses go the other way
+// through a second one. Neither thread ever waits for the other. Headless
+// runs step the simulation once per frame on the one thread so that they
+// repeat exactly.
+//
+
+atlas_region background;
+
+// set when frames go to an offscreen target rather than a GLUT window
+bool headless = false;
+
+// the performance overlay starts hidden unless --hud is given
+bool show_hud = false;
+
+// Arrow Key Setup
+bool* key_special_states = new bool[246];
+bool* key_states = new bool[256];
+
+void keySpecial (int key, int x, int y) {
+	key_special_states[key] = true;
+}
+void keySpecialUp (int key, int x, int y) {
+	key_special_states[key] = false;
+}
+
+// the keys held down, as the simulation sees them
+struct input_state {
+  char keys[256];
+  bool special[246];
+};
+
+// everything the renderer needs from one simulation tick
+struct frame_snapshot {
+  render_list boxes;              // every visible entity
+  std::vector<unsigned> bricks;   // one alive bit per brick
+  particle_snapshot particles;
+  int scores[2];
+  float time;                     // simulation seconds
+  double sim_ms;                  // how long the tick took
+};
+
+			// THE GAME
+template <class Rules>
+class NewPongGame
+{
+  // game state: always uses enums for int constants
+  enum state_t {
+    state_serving,
+    state_playing,
+    state_end,
+  };
+
+  state_t state;
+  int server;
+
+  // sparks from every impact
+  enum { max_particles = 256 * 1024 };
+
+  // the rules of this mode
+  typename Rules::scoring scoring_;
+  typename Rules::obstacle obstacle_;
+  typename Rules::bricks bricks_;
+  typename Rules::players players_;
+  typename Rules::court court_;
+
+  // every game object is an entity in the world
+  world world_;
+  entity_id bats[2];
+  entity_id ball;
+  contact_list contacts_;
+  obb_set obbs_;
+  script_runner scripts_;
+  particle_system particles_;
+  int scores[2];
+
+  // the simulation thread and what passes between it and the renderer
+  triple_buffer<frame_snapshot> frames_;
+  triple_buffer<input_state> input_;
+  std::thread sim_thread_;
+  std::atomic<bool> quit_;
+
+  // rendering: boxes are instanced where the driver allows it,
+  // everything else goes through one sprite batch
+  GLint viewport_width_;
+  GLint viewport_height_;
+  shader sprite_shader_;
+  shader upscale_shader_;
+  sprite_batch batch_;
+  instanced_boxes instances_;
+  particle_batch particle_batch_;
+  gpu_ring ring_;
+  unsigned frame_;
+  bool gl_ready_;
+  render_graph graph_;              // the frame's passes and their targets
+  GLint output_framebuffer_;        // the window's, or the headless target
+  render_list render_list_;   // bricks drawn without instancing
+  render_queue render_queue_; // the world, sorted by state before it is drawn
+
+  // the performance overlay, toggled with 'h'
+  bool hud_;
+  double frame_ms_;
+
+  // input, on the GLUT thread
+  char keys[256];
+
+  // constants: always use functions for floats!
+  float ball_speed() { return 0.01f; }
+
+  // component accessors
+  vec4 &pos(entity_id e) { return world_.get<vec4>(e, component_position); }
+  vec4 &extent(entity_id e) { return world_.get<vec4>(e, component_extent); }
+  vec4 &velocity(entity_id e) { return world_.get<vec4>(e, component_velocity); }
+
+  // the keys as the simulation sees them: only the simulation calls this
+  const input_state &input() { return input_.front(); }
+
+  void draw_world(frame_snapshot &snapshot)
+  {
+    // record every visible entity once. with instancing the bricks are
+    // drawn from their own retained mesh.
+    render_queue_.clear();
+    command_buffer &commands = render_queue_.buffer(0);
+    commands.set_layer(layer_world);
+    render_list &boxes = snapshot.boxes;
+    if (instances_.supported()) {
+      commands.set_pipeline(pipeline_bricks);
+      commands.draw();
+      commands.set_pipeline(pipeline_boxes);
+      for (unsigned i = 0; i != boxes.size(); ++i) {
+        boxes[i].draw(commands);
+      }
+      commands.set_layer(layer_effects);
+      commands.set_pipeline(pipeline_particles);
+      commands.draw();
+    } else {
+      commands.set_pipeline(pipeline_sprite);
+      for (unsigned i = 0; i != boxes.size(); ++i) {
+        boxes[i].draw(commands);
+      }
+      render_list_.clear();
+      bricks_.extract(render_list_, snapshot.bricks);
+      for (unsigned i = 0; i != render_list_.size(); ++i) {
+        render_list_[i].draw(commands);
+      }
+      commands.set_layer(layer_effects);
+      draw_particles(commands, snapshot.particles);
+    }
+    render_queue_.sort();
+    submit(snapshot);
+  }
+
+  // draw the sorted commands: each renderer is switched to once per run
+  void submit(const frame_snapshot &snapshot) {
+    render_queue &queue = render_queue_;
+    for (unsigned i = 0, n = queue.size(); i != n; ++i) {
+      const render_command &c = queue[i];
+      switch (c.pipeline()) {
+        case pipeline_sprite:
+          if (c.texture()) {
+            vec4 x(c.ax * c.hx, c.ay * c.hx, 0, 0), y(-c.ay * c.hy, c.ax * c.hy, 0, 0);
+            batch_.set_texture(c.texture());
+            batch_.quad(c.center(), x, y, unpack_color(c.color), c.u0, c.v0, c.u1, c.v1);
+          } else {
+            batch_.box(c.center(), c.half_extents(), unpack_color(c.color), c.axis());
+          }
+          break;
+        case pipeline_boxes: {
+          // the whole run is one instanced draw
+          unsigned end = i + 1;
+          while (end != n && queue[end].pipeline() == pipeline_boxes) ++end;
+          batch_.flush();
+          instances_.begin(end - i);
+          for (unsigned j = i; j != end; ++j) {
+            const render_command &b = queue[j];
+            instances_.add(b.center(), b.half_extents(), unpack_color(b.color), b.axis());
+          }
+          instances_.draw();
+          i = end - 1;
+          break;
+        }
+        case pipeline_bricks:
+          batch_.flush();
+          bricks_.draw(instances_, snapshot.bricks);
+          break;
+        case pipeline_particles:
+          batch_.flush();
+          particle_batch_.draw(snapshot.particles);
+          break;
+      }
+    }
+  }
+
+   // called when someone scores
+  void adjust_score(int player) {
+    scores[player]++;
+
+    velocity(ball) = vec4(0, 0, 0, 0);
+    if (scores[player] >= Rules::scoring::points_to_win) {
+      state = state_end;
+      scoring_.game_over();
+    } else
+    {
+      server = 1 - player;
+      state = state_serving;
+    }
+  }
+
+  // glue the ball to the server's bat
+  void glue_ball() {
+    vec4 offset = vec4(server ? -0.1f : 0.1f, 0, 0, 0);
+    pos(ball) = pos(bats[server]) + offset;
+  }
+
+  // every serve of the game, one after another
+  script serve_script() {
+    for (;;) {
+      while (state != state_serving) {
+        co_await next_tick();
+      }
+
+      // hold the ball on the bat until the server is allowed to hit it...
+      for (unsigned tick = 0; tick * scripts_.tick_seconds() < players_.serve_delay(); ++tick) {
+        glue_ball();
+        co_await next_tick();
+      }
+
+      // ...and then until they do
+      glue_ball();
+      while (!players_.wants_serve(server, input().keys)) {
+        co_await next_tick();
+        glue_ball();
+      }
+
+      state = state_playing;
+      velocity(ball) = vec4(server ? -ball_speed() : ball_speed(), ball_speed() * players_.serve_slope(), 0, 0);
+      co_await next_tick();
+    }
+  }
+
+  void do_playing()
+  {
+    // bounce off the walls and find everything the ball touches
+    collision_system(world_, court_.court_size(), contacts_);
+
+    for (unsigned i = 0; i != contacts_.size(); ++i) {
+      const contact &c = contacts_[i];
+      if (!world_.alive(c.ball) || !world_.alive(c.other)) {
+        continue;
+      }
+      vec4 &ball_pos = pos(c.ball);
+      vec4 &ball_velocity = velocity(c.ball);
+      if (c.flags & collide_bat) {
+        if (bounce_off_bat(ball_pos, ball_velocity, pos(c.other))) {
+          ball_velocity = ball_velocity * scoring_.bat_speedup();
+          particles_.emit(ball_pos, 32, 0.6f, 0xffffffff, 0.5f);
+        }
+      } else if (c.flags & collide_bounce) {
+        bounce_off_box(ball_pos, ball_velocity, extent(c.ball), pos(c.other), extent(c.other));
+      }
+      if (c.flags & collide_destroy) {
+        particles_.emit(pos(c.other), 64, 0.8f, pack_color(world_.get<vec4>(c.other, component_color)), 0.8f);
+        world_.destroy(c.other);
+      }
+    }
+
+    obb_collision_system(world_, obbs_);
+    bricks_.collide(pos(ball), velocity(ball), extent(ball), particles_);
+
+    int scorer = scoring_system(world_);
+    if (scorer >= 0) {
+      adjust_score(scorer);
+      bricks_.reset(world_);
+    }
+  }
+
+  // simulation for the game
+  void simulate() {
+    input_.acquire();
+    players_.move_bats(world_, bats, ball, state == state_playing, input().keys, input().special);
+    movement_system(world_);
+    rotation_system(world_);
+
+    // serves, obstacles and anything else that is scripted
+    scripts_.tick();
+
+    if (state == state_playing) {
+      do_playing();
+    }
+    particles_.update(scripts_.tick_seconds());
+  }
+
+  void draw_background() {
+    gl_state::get().depth_test(false);
+    batch_.sprite(background, vec4(0, 0, 0, 1), vec4(0.5f, 0.5f, 0, 0), vec4(1, 1, 1, 1));
+  }
+
+  // one simulation tick, handed to the renderer as a snapshot
+  void step() {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    simulate();
+
+    frame_snapshot &snapshot = frames_.back();
+    render_extraction_system(world_, snapshot.boxes);
+    bricks_.snapshot(snapshot.bricks);
+    particles_.snapshot(snapshot.particles);
+    snapshot.scores[0] = scores[0];
+    snapshot.scores[1] = scores[1];
+    snapshot.time = scripts_.now() * scripts_.tick_seconds();
+    snapshot.sim_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    frames_.publish();
+  }
+
+  // the simulation thread: tick on a fixed grid of deadlines
+  void simulation_loop() {
+    typedef std::chrono::steady_clock clock;
+    clock::duration tick = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(scripts_.tick_seconds()));
+    clock::time_point next = clock::now();
+    while (!quit_.load(std::memory_order_relaxed)) {
+      step();
+      next += tick;
+      clock::time_point now = clock::now();
+      if (now - next > tick * 4) {
+        // a long stall: drop the time rather than run a burst of ticks
+        next = now;
+      }
+      std::this_thread::sleep_until(next);
+    }
+  }
+
+  void start_simulation() {
+    quit_ = false;
+    sim_thread_ = std::thread(&NewPongGame::simulation_loop, this);
+  }
+
+  // hand the keys to the simulation
+  void publish_input() {
+    input_state &in = input_.back();
+    memcpy(in.keys, keys, sizeof(in.keys));
+    memcpy(in.special, key_special_states, sizeof(in.special));
+    input_.publish();
+  }
+
+  // frame rate, simulation time, draw calls and heap allocations of the last frame
+  void draw_hud(const frame_snapshot &snapshot) {
+    // smooth the frame time so the numbers can be read
+    double ms = frame_pacer::get().last_frame_ms();
+    frame_ms_ = frame_ms_ ? frame_ms_ * 0.9 + ms * 0.1 : ms;
+
+    char text[64];
+    float height = 0.04f, x = -0.98f, y = -0.75f;
+    dynamic_resolution &scaler = dynamic_resolution::get();
+    if (scaler.enabled()) {
+      sprintf_s(text, sizeof(text), "res %d%%", (int)(scaler.scale() * 100));
+      draw_text(batch_, text, x, y + height * 1.5f, height, vec4(1, 1, 0, 1));
+    }
+    vec4 color(1, 1, 0, 1);
+    sprintf_s(text, sizeof(text), "FPS %.1f", frame_ms_ > 0 ? 1000 / frame_ms_ : 0);
+    draw_text(batch_, text, x, y, height, color);
+    sprintf_s(text, sizeof(text), "sim %.3fms", snapshot.sim_ms);
+    draw_text(batch_, text, x, y - height * 1.5f, height, color);
+    sprintf_s(text, sizeof(text), "draws %u", render_stats::get().draw_calls());
+    draw_text(batch_, text, x, y - height * 3, height, color);
+    sprintf_s(text, sizeof(text), "allocs %u", alloc_stats::get().allocations());
+    draw_text(batch_, text, x, y - height * 4.5f, height, color);
+  }
+
+  // show the draw calls of the last frame and the frame times so far
+  // in the title bar about once a second, and log the GPU pass times
+  void show_stats() {
+    render_stats &stats = render_stats::get();
+    frame_histogram &times = frame_pacer::get().histogram();
+    stats.end_frame();
+    alloc_stats::get().end_frame();
+    if (++frame_ % 32 == 0) {
+      char title[160];
+      sprintf_s(
+        title, sizeof(title), "%s - %u draw calls, %u quads, %u state calls (%u skipped), p50 %.1fms p99 %.1fms",
+        Rules::title(), stats.draw_calls(), stats.quads(), stats.state_calls(), stats.skipped_calls(),
+        times.percentile(0.5), times.percentile(0.99)
+      );
+      if (!headless) {
+        glutSetWindowTitle(title);
+        gpu_timers::get().dump();
+      }
+    }
+  }
+
+  // draw the newest snapshot of the game world every frame
+  void render() {
+    if (!gl_ready_) init_gl();
+
+    if (headless) {
+      publish_input();
+      step();
+    }
+    frames_.acquire();
+    frame_snapshot &snapshot = frames_.front();
+
+    // the graph times each pass on the GPU when asked to. the batch is
+    // flushed at the end of each pass so that its draws land in the right one.
+    gpu_timers &timers = gpu_timers::get();
+    timers.begin_frame();
+    dynamic_resolution &scaler = dynamic_resolution::get();
+    scaler.update(timers.frame_ms("frame"));
+    timers.begin("frame");
+
+    // when the GPU is behind, draw the scene smaller into a texture of the
+    // graph's and scale it up after
+    int width = viewport_width_, height = viewport_height_;
+    bool scaled = !scaler.full_size();
+    if (scaled) {
+      width = scaler.scaled(width);
+      height = scaler.scaled(height);
+    }
+    render_resource output = graph_.import("output", output_framebuffer_, viewport_width_, viewport_height_);
+    render_resource scene = scaled ? graph_.create("scene", width + 1, height + 1) : output;
+
+    ring_.begin_frame();
+
+    // everything that every shader needs this frame, in one upload
+    frame_uniforms &frame = frame_uniform_buffer::get().data();
+    frame.view_proj.loadIdentity();
+    frame.params = vec4(snapshot.time, 1.0f / width, 1.0f / height, 0);
+    frame_uniform_buffer::get().upload(ring_);
+
+    // clear the frame buffer and the depth, and draw the background
+    auto background = [&] {
+      graph_.bind(scene);
+
+      // a scaled scene clears a texel past its corner too, so that filtering
+      // at its edges blends with the clear color and not a bigger frame's leftovers
+      if (scaled) {
+        glScissor(0, 0, width + 1, height + 1);
+        glEnable(GL_SCISSOR_TEST);
+      }
+      vec4 clear = court_.clear_color();
+      glClearColor(clear[0], clear[1], clear[2], clear[3]);
+      gl_state::get().viewport(0, 0, width, height);
+      glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+      if (scaled) glDisable(GL_SCISSOR_TEST);
+
+      batch_.set_shader(sprite_shader_);
+      if (Rules::court::textured_background) {
+        draw_background();
+        if (timers.enabled()) batch_.flush();
+      }
+    };
+
+    auto world = [&] {
+      draw_world(snapshot);
+      scoring_.draw_scores(batch_, snapshot.scores);
+      if (!scaled && hud_) draw_hud(snapshot);
+      batch_.flush();
+    };
+
+    auto upscale = [&] {
+      graph_.bind(output);
+      gl_state::get().viewport(0, 0, viewport_width_, viewport_height_);
+      batch_.set_shader(upscale_shader_);
+      batch_.sprite(graph_.region(scene, width, height), vec4(0, 0, 0, 1), vec4(1, 1, 0, 0), vec4(1, 1, 1, 1));
+      batch_.flush();
+      batch_.set_shader(sprite_shader_);
+    };
+
+    // the overlay stays sharp at the window's own resolution
+    auto hud = [&] {
+      draw_hud(snapshot);
+      batch_.flush();
+    };
+
+    // hand the finished frame to the recorder before it is swapped away
+    frame_capture &capture = frame_capture::get();
+    auto record = [&] {
+      graph_.bind(output);
+      capture.capture(viewport_width_, viewport_height_);
+    };
+
+    graph_.add_pass("background", background).write(scene);
+    graph_.add_pass("world", world).write(scene);
+    if (scaled) {
+      graph_.add_pass("upscale", upscale).read(scene).write(output);
+      if (hud_) graph_.add_pass("hud", hud).write(output);
+    }
+    if (capture.enabled()) graph_.add_pass("capture", record).read(output).side_effect();
+    graph_.execute();
+    ring_.end_frame();
+    timers.end();
+    show_stats();
+
+    // swap buffers so that the image is displayed.
+    // gets a new buffer to draw a new scene.
+    if (!headless) {
+      timers.begin("swap");
+      glutSwapBuffers();
+      timers.end();
+      frame_pacer::get().frame_done();
+    }
+  }
+
+  // the same frame drawn on the CPU, for machines with no GL
+  void render_soft(soft_rasterizer &raster, const soft_texture &soft_background) {
+    publish_input();
+    step();
+    frames_.acquire();
+    frame_snapshot &snapshot = frames_.front();
+
+    raster.begin(viewport_width_, viewport_height_, court_.clear_color());
+    if (Rules::court::textured_background) {
+      raster.sprite(soft_background, vec4(0, 0, 0, 1), vec4(0.5f, 0.5f, 0, 0), vec4(1, 1, 1, 1));
+    }
+    for (unsigned i = 0; i != snapshot.boxes.size(); ++i) {
+      snapshot.boxes[i].draw(raster);
+    }
+    render_list_.clear();
+    bricks_.extract(render_list_, snapshot.bricks);
+    for (unsigned i = 0; i != render_list_.size(); ++i) {
+      render_list_[i].draw(raster);
+    }
+    draw_particles(raster, snapshot.particles);
+    scoring_.draw_scores(raster, snapshot.scores);
+    raster.finish();
+  }
+
+  // shaders and buffers, made on the first GL frame so that
+  // software rendering never needs a context
+  void init_gl() {
+    // one shader for every sprite: the texture tinted by the vertex color.
+    // plain boxes use a white texture so the color comes straight through,
+    // and clear texels (around the glyphs of text) are not drawn.
+    sprite_shader_.init(
+      "varying vec2 uv_;"
+      "varying vec4 color_;"
+      "attribute vec4 pos;"
+      "attribute vec2 uv;"
+      "attribute vec4 color;"
+      "void main() { gl_Position = view_proj * pos; uv_ = uv; color_ = color; }",
+
+      "varying vec2 uv_;"
+      "varying vec4 color_;"
+      "uniform sampler2D tex;"
+      "void main() {"
+      "  vec4 c = texture2D(tex, uv_) * color_;"
+      "  if (c.a < 0.5) discard;"
+      "  gl_FragColor = c;"
+      "}"
+    );
+    // the scene, when it is drawn small, is copied up with no alpha test
+    upscale_shader_.init(
+      "varying vec2 uv_;"
+      "attribute vec4 pos;"
+      "attribute vec2 uv;"
+      "void main() { gl_Position = view_proj * pos; uv_ = uv; }",
+
+      "varying vec2 uv_;"
+      "uniform sampler2D tex;"
+      "void main() { gl_FragColor = texture2D(tex, uv_); }"
+    );
+
+    // room for a few thousand boxes a frame before the ring has to grow
+    ring_.init(256 * 1024);
+    batch_.init(ring_);
+    render_queue_.init(1);
+    instances_.init(ring_);
+    particle_batch_.init(ring_);
+
+    // untextured boxes share the atlas page with the background
+    batch_.set_white(texture_atlas::get().white());
+
+    // dynamic resolution draws the scene into a framebuffer object
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &output_framebuffer_);
+    if (dynamic_resolution::get().enabled() && !gl_version_at_least(3, 0) && !gl_has_extension("GL_ARB_framebuffer_object")) {
+      printf("dynamic resolution: no framebuffer objects on this driver\n");
+      dynamic_resolution::get().disable();
+    }
+    gl_ready_ = true;
+  }
+
+  // set up the world
+  NewPongGame()
+  {
+    memset(keys, 0, sizeof(keys));
+	memset(key_states,0,256);
+	memset(key_special_states,0,246);
+
+    // set up game state.
+    scores[0] = 0;
+    scores[1] = 0;
+    state = state_serving;
+    server = 0;
+    frame_ = 0;
+    gl_ready_ = false;
+    output_framebuffer_ = 0;
+    hud_ = show_hud;
+    frame_ms_ = 0;
+    quit_ = false;
+
+    // make the bats and ball
+    float bat_hx = 0.02f;
+    float bat_hy = 0.10f;
+    float bat_cx = 1 - bat_hx * 2;
+    component_mask bat_mask =
+      component_bit(tag_bat) | component_bit(component_velocity) |
+      component_bit(component_collider) | component_bit(component_player)
+    ;
+    for (int player = 0; player != 2; ++player) {
+      bats[player] = spawn_box(world_, bat_mask, player ? bat_cx : -bat_cx, 0, bat_hx, bat_hy);
+      velocity(bats[player]) = vec4(0, 0, 0, 0);
+      world_.get<unsigned>(bats[player], component_collider) = collide_bat;
+      world_.get<int>(bats[player], component_player) = player;
+    }
+    float ball_hx = court_.ball_size();
+    float ball_hy = court_.ball_size();
+    ball = spawn_box(world_, component_bit(tag_ball) | component_bit(component_velocity), 0, 0, ball_hx, ball_hy);
+    velocity(ball) = vec4(0, 0, 0, 0);
+
+    obstacle_.init(world_, scripts_);
+    bricks_.init(world_);
+    particles_.init(max_particles);
+    scripts_.spawn(serve_script());
+  }
+
+  ~NewPongGame() {
+    if (sim_thread_.joinable()) {
+      quit_ = true;
+      sim_thread_.join();
+    }
+  }
+
+  // The viewport defines the drawing area in the window
+  void set_viewport(int w, int h) {
+    viewport_width_ = w;
+    viewport_height_ = h;
+  }
+
+  void set_key(int key, int value) {
+    if (key == 'h' && value && !keys['h']) hud_ = !hud_;
+    keys[key & 0xff] = value;
+    publish_input();
+  }
+
+public:
+  // a singleton: one instance of this class only!
+  static NewPongGame &get()
+  {
+    static NewPongGame singleton;
+    return singleton;
+  }
+
+  // interface from GLUT
+  static void reshape(int w, int h) { get().set_viewport(w, h); }
+  static void display() { get().render(); }
+  static void display_soft(soft_rasterizer &raster, const soft_texture &soft_background) { get().render_soft(raster, soft_background); }
+  static void idle() { frame_pacer::get().wait(); glutPostRedisplay(); }
+  static void key_down( unsigned char key, int x, int y) { get().set_key(key, 1); }
+  static void key_up( unsigned char key, int x, int y) { get().set_key(key, 0); }
+  static void special_down(int key, int x, int y) { keySpecial(key, x, y); get().publish_input(); }
+  static void special_up(int key, int x, int y) { keySpecialUp(key, x, y); get().publish_input(); }
+
+  // hand this mode's callbacks to GLUT
+  static void install() {
+    glutDisplayFunc(display);
+    glutReshapeFunc(reshape);
+    glutKeyboardFunc(key_down);
+    glutKeyboardUpFunc(key_up);
+    glutIdleFunc(idle);
+    glutSpecialFunc(special_down);
+    glutSpecialUpFunc(special_up);
+    get().start_simulation();
+  }
+};
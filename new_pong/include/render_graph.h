@@ -0,0 +1,314 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// render graph
+//
+// render() declares the frame's passes instead of binding framebuffers by
+// hand. Each pass names the resources it reads and writes, and then the graph
+//
+//   - culls passes that nothing needs: a pass is kept if it writes an
+//     imported resource (the window), has side effects (capture), or writes
+//     something a kept pass reads,
+//   - orders the passes: a reader runs after every writer of what it reads,
+//     and writers of the same resource run in the order they were declared,
+//   - gives each transient resource an offscreen_target from a pool for its
+//     lifetime only, from the first pass that uses it to the last.
+//
+// GL has no way to place two textures in the same memory, so aliasing here
+// means that transient resources whose lifetimes do not overlap share one
+// target; as with offscreen_target itself, a smaller one draws into the
+// corner of a bigger one. The pool keeps its targets from frame to frame.
+// When a new or bigger target would push it over its byte budget, it first
+// frees idle targets; a frame that needs more than the budget is reported.
+//
+// Passes are lambdas that must live until execute():
+//
+//   render_resource scene = graph.create("scene", w, h);
+//   auto world = [&] { graph.bind(scene); ... };
+//   auto upscale = [&] { graph.bind(output); ... graph.region(scene, w, h) ... };
+//   graph.add_pass("world", world).write(scene);
+//   graph.add_pass("upscale", upscale).read(scene).write(output);
+//   graph.execute();
+//
+// Each pass is timed by gpu_timers under its name. Nothing allocates once
+// the graph has seen its biggest frame.
+//
+
+typedef unsigned render_resource;
+
+class render_pass {
+  friend class render_graph;
+  enum { max_uses = 4 };
+
+  const char *name_;
+  void (*run_)(void *context);
+  void *context_;
+  render_resource reads_[max_uses], writes_[max_uses];
+  unsigned num_reads_, num_writes_;
+  bool side_effect_;
+
+  bool reads(render_resource r) const {
+    for (unsigned i = 0; i != num_reads_; ++i) if (reads_[i] == r) return true;
+    return false;
+  }
+
+  bool writes(render_resource r) const {
+    for (unsigned i = 0; i != num_writes_; ++i) if (writes_[i] == r) return true;
+    return false;
+  }
+public:
+  render_pass &read(render_resource r) { assert(num_reads_ != max_uses); reads_[num_reads_++] = r; return *this; }
+  render_pass &write(render_resource r) { assert(num_writes_ != max_uses); writes_[num_writes_++] = r; return *this; }
+
+  // keep the pass even if nothing reads what it writes
+  render_pass &side_effect() { side_effect_ = true; return *this; }
+};
+
+class render_graph {
+  enum {
+    max_passes = 32,
+    none = -1,
+  };
+
+  struct resource {
+    const char *name;
+    int width, height;
+    GLint framebuffer;      // imported resources
+    bool imported;
+    int target;             // the pool's, while it is alive
+    int first, last;        // positions in the order of the passes that use it
+  };
+
+  struct pooled_target {
+    offscreen_target target;
+    bool busy;
+    unsigned last_frame;    // the frame it was last used in
+  };
+
+  std::vector<render_pass> passes_;
+  std::vector<resource> resources_;
+  std::vector<unsigned> order_;
+  unsigned deps_[max_passes];   // bit j: pass j has to run first
+
+  std::vector<pooled_target> pool_;
+  size_t budget_, pool_bytes_;
+  unsigned frame_;
+  bool reported_cycle_, reported_budget_;
+
+  template <class F> static void call(void *f) { (*(F*)f)(); }
+
+  // who depends on whom, from the reads and writes
+  void find_dependencies() {
+    unsigned n = (unsigned)passes_.size();
+    for (unsigned i = 0; i != n; ++i) deps_[i] = 0;
+    for (render_resource r = 0; r != resources_.size(); ++r) {
+      unsigned writers = 0;
+      int last_writer = none;
+      for (unsigned i = 0; i != n; ++i) {
+        if (!passes_[i].writes(r)) continue;
+        if (last_writer != none) deps_[i] |= 1u << last_writer;
+        last_writer = (int)i;
+        writers |= 1u << i;
+      }
+      for (unsigned i = 0; i != n; ++i) {
+        if (passes_[i].reads(r) && !passes_[i].writes(r)) deps_[i] |= writers;
+      }
+    }
+  }
+
+  // the passes that are needed
+  unsigned find_live() {
+    unsigned n = (unsigned)passes_.size(), live = 0;
+    for (unsigned i = 0; i != n; ++i) {
+      const render_pass &p = passes_[i];
+      bool root = p.side_effect_;
+      for (unsigned w = 0; w != p.num_writes_; ++w) root = root || resources_[p.writes_[w]].imported;
+      if (root) live |= 1u << i;
+    }
+    for (unsigned changed = live; changed; ) {
+      unsigned more = 0;
+      for (unsigned i = 0; i != n; ++i) {
+        if ((changed >> i) & 1) more |= deps_[i];
+      }
+      changed = more & ~live;
+      live |= more;
+    }
+    return live;
+  }
+
+  // live passes, each after everything it depends on, otherwise as declared
+  void find_order(unsigned live) {
+    order_.clear();
+    unsigned remaining = live;
+    while (remaining) {
+      unsigned i = 0;
+      while (i != passes_.size() && (!((remaining >> i) & 1) || (deps_[i] & remaining))) ++i;
+      if (i == passes_.size()) {
+        if (!reported_cycle_) printf("render graph: the passes depend on each other in a cycle\n");
+        reported_cycle_ = true;
+        for (i = 0; i != passes_.size(); ++i) {
+          if ((remaining >> i) & 1) order_.push_back(i);
+        }
+        return;
+      }
+      order_.push_back(i);
+      remaining &= ~(1u << i);
+    }
+  }
+
+  void find_lifetimes() {
+    for (unsigned k = 0; k != order_.size(); ++k) {
+      const render_pass &p = passes_[order_[k]];
+      for (unsigned u = 0; u != p.num_reads_ + p.num_writes_; ++u) {
+        resource &r = resources_[u < p.num_reads_ ? p.reads_[u] : p.writes_[u - p.num_reads_]];
+        if (r.first == none) r.first = (int)k;
+        r.last = (int)k;
+      }
+    }
+  }
+
+  // free idle targets until bytes more would fit in the budget. a freed
+  // target keeps its place in the pool, empty, so indices stay valid.
+  void make_room(size_t bytes, int keep) {
+    for (size_t i = pool_.size(); i-- != 0 && pool_bytes_ + bytes > budget_; ) {
+      pooled_target &t = pool_[i];
+      if (t.busy || (int)i == keep || t.last_frame == frame_ || !t.target.ready()) continue;
+      pool_bytes_ -= t.target.bytes();
+      t.target.destroy();
+    }
+    if (pool_bytes_ + bytes > budget_ && !reported_budget_) {
+      printf("render graph: %u bytes of targets, over the budget of %u\n", (unsigned)(pool_bytes_ + bytes), (unsigned)budget_);
+      reported_budget_ = true;
+    }
+  }
+
+  // a free target at least w by h: the smallest that fits, or else the
+  // biggest free one grown, or else a new one
+  int acquire(int w, int h) {
+    int best = none, biggest = none, empty = none;
+    for (unsigned i = 0; i != pool_.size(); ++i) {
+      const offscreen_target &t = pool_[i].target;
+      if (pool_[i].busy) continue;
+      if (!t.ready()) {
+        empty = (int)i;
+        continue;
+      }
+      size_t area = (size_t)t.width() * t.height();
+      if (t.width() >= w && t.height() >= h) {
+        if (best == none || area < (size_t)pool_[best].target.width() * pool_[best].target.height()) best = (int)i;
+      } else if (biggest == none || area > (size_t)pool_[biggest].target.width() * pool_[biggest].target.height()) {
+        biggest = (int)i;
+      }
+    }
+
+    if (best == none && biggest != none) {
+      offscreen_target &t = pool_[biggest].target;
+      size_t before = t.bytes();
+      size_t after = (size_t)(w > t.width() ? w : t.width()) * (h > t.height() ? h : t.height()) * 8;
+      make_room(after - before, biggest);
+      best = biggest;
+    }
+    if (best == none) {
+      make_room((size_t)w * h * 8, none);
+      if (empty == none) {
+        pool_.push_back(pooled_target());
+        empty = (int)pool_.size() - 1;
+      }
+      pool_[empty].target.init(w, h, true);
+      pool_bytes_ += pool_[empty].target.bytes();
+      best = empty;
+    }
+
+    pooled_target &t = pool_[best];
+    pool_bytes_ -= t.target.bytes();
+    t.target.reserve(w, h);
+    pool_bytes_ += t.target.bytes();
+    t.busy = true;
+    t.last_frame = frame_;
+    return best;
+  }
+
+public:
+  enum { default_budget = 64 << 20 };
+
+  render_graph() {
+    budget_ = default_budget;
+    pool_bytes_ = 0;
+    frame_ = 0;
+    reported_cycle_ = reported_budget_ = false;
+  }
+
+  // the most bytes of pooled targets to keep
+  void set_budget(size_t bytes) { budget_ = bytes; }
+  size_t pool_bytes() const { return pool_bytes_; }
+
+  // a framebuffer that lives outside the graph, like the window's
+  render_resource import(const char *name, GLint framebuffer, int width, int height) {
+    resource r = { name, width, height, framebuffer, true, none, none, none };
+    resources_.push_back(r);
+    return (render_resource)resources_.size() - 1;
+  }
+
+  // a color texture with depth that only lives for this frame
+  render_resource create(const char *name, int width, int height) {
+    resource r = { name, width, height, 0, false, none, none, none };
+    resources_.push_back(r);
+    return (render_resource)resources_.size() - 1;
+  }
+
+  // the returned pass is valid until the next add_pass
+  template <class F> render_pass &add_pass(const char *name, F &execute) {
+    assert(passes_.size() != max_passes);
+    render_pass p;
+    p.name_ = name;
+    p.run_ = &call<F>;
+    p.context_ = &execute;
+    p.num_reads_ = p.num_writes_ = 0;
+    p.side_effect_ = false;
+    passes_.push_back(p);
+    return passes_.back();
+  }
+
+  // for passes: draw into a resource...
+  void bind(render_resource r) {
+    const resource &res = resources_[r];
+    if (res.imported) {
+      glBindFramebuffer(GL_FRAMEBUFFER, res.framebuffer);
+    } else {
+      pool_[res.target].target.bind();
+    }
+  }
+
+  // ...or draw the w by h corner of one as a sprite
+  atlas_region region(render_resource r, int w, int h) const {
+    return pool_[resources_[r].target].target.corner(w, h);
+  }
+
+  // cull, order and run the passes, then start again for the next frame
+  void execute() {
+    find_dependencies();
+    find_order(find_live());
+    find_lifetimes();
+
+    gpu_timers &timers = gpu_timers::get();
+    for (unsigned k = 0; k != order_.size(); ++k) {
+      for (unsigned r = 0; r != resources_.size(); ++r) {
+        resource &res = resources_[r];
+        if (!res.imported && res.first == (int)k) res.target = acquire(res.width, res.height);
+      }
+
+      render_pass &p = passes_[order_[k]];
+      timers.begin(p.name_);
+      p.run_(p.context_);
+      timers.end();
+
+      for (unsigned r = 0; r != resources_.size(); ++r) {
+        resource &res = resources_[r];
+        if (!res.imported && res.last == (int)k) pool_[res.target].busy = false;
+      }
+    }
+
+    passes_.clear();
+    resources_.clear();
+    frame_++;
+  }
+};
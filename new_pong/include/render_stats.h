@@ -0,0 +1,53 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// per-frame render counters
+//
+// Anything that issues a draw call reports it here, and gl_state reports
+// every state change it is asked for. end_frame() latches the totals so they
+// can be shown while the next frame is being counted.
+//
+
+class render_stats {
+  unsigned draw_calls_;
+  unsigned quads_;
+  unsigned state_calls_;
+  unsigned skipped_calls_;
+  unsigned last_draw_calls_;
+  unsigned last_quads_;
+  unsigned last_state_calls_;
+  unsigned last_skipped_calls_;
+
+  render_stats() {
+    draw_calls_ = quads_ = state_calls_ = skipped_calls_ = 0;
+    last_draw_calls_ = last_quads_ = last_state_calls_ = last_skipped_calls_ = 0;
+  }
+public:
+  void draw_call(unsigned quads) {
+    draw_calls_++;
+    quads_ += quads;
+  }
+
+  // issued is false when the state was already set and the call was skipped
+  void state_call(bool issued) {
+    if (issued) state_calls_++; else skipped_calls_++;
+  }
+
+  void end_frame() {
+    last_draw_calls_ = draw_calls_;
+    last_quads_ = quads_;
+    last_state_calls_ = state_calls_;
+    last_skipped_calls_ = skipped_calls_;
+    draw_calls_ = quads_ = state_calls_ = skipped_calls_ = 0;
+  }
+
+  // totals for the last finished frame
+  unsigned draw_calls() const { return last_draw_calls_; }
+  unsigned quads() const { return last_quads_; }
+  unsigned state_calls() const { return last_state_calls_; }
+  unsigned skipped_calls() const { return last_skipped_calls_; }
+
+  static render_stats &get() {
+    static render_stats the_stats;
+    return the_stats;
+  }
+};
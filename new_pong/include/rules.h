@@ -0,0 +1,432 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// rule-set policies
+//
+// NewPongGame<Rules> takes one policy of each kind from its Rules class.
+// Policies are plain classes with inline members, so each mode gets its own
+// fully specialized simulate() with no virtual calls and no mode checks.
+//
+
+// entity masks shared by the policies
+inline component_mask visible_mask() {
+  return component_bit(component_position) | component_bit(component_extent) | component_bit(component_color);
+}
+
+// make an entity with the components every visible object has
+inline entity_id spawn_box(world &w, component_mask mask, float cx, float cy, float hx, float hy) {
+  entity_id e = w.create(mask | visible_mask());
+  w.get<vec4>(e, component_position) = vec4(cx, cy, 0, 1);
+  w.get<vec4>(e, component_extent) = vec4(hx, hy, 0, 0);
+  w.get<vec4>(e, component_color) = vec4(1, 1, 1, 1);
+  return e;
+}
+
+//
+// scoring rules
+//
+
+// classic pong: first to 11, scores across the top of each half
+class first_to_eleven {
+public:
+  enum { points_to_win = 11 };
+
+  // velocity scale when the ball leaves a bat
+  vec4 bat_speedup() const { return vec4(1, 1, 1, 1); }
+
+  template <class Sink> void draw_scores(Sink &sink, const int scores[2]) {
+    char text[16];
+    for (int player = 0; player != 2; ++player) {
+      sprintf_s(text, sizeof(text), "%d", scores[player]);
+      draw_text(sink, text, player == 0 ? -0.9f : 0.5f, 0.78f, 0.12f, vec4(1, 1, 1, 1));
+    }
+  }
+
+  void game_over() {}
+};
+
+// brick mode: first to 6, the ball speeds up off the bats
+class first_to_six {
+public:
+  enum { points_to_win = 6 };
+
+  vec4 bat_speedup() const { return vec4(1.1f, 1.1f, 1, 1); }
+
+  // small, either side of the middle at the top
+  template <class Sink> void draw_scores(Sink &sink, const int scores[2]) {
+    char text[16];
+    float height = 0.05f;
+    sprintf_s(text, sizeof(text), "%d", scores[0]);
+    draw_text(sink, text, -0.05f - text_width(text, height), 0.99f, height, vec4(1, 1, 1, 1));
+    sprintf_s(text, sizeof(text), "%d", scores[1]);
+    draw_text(sink, text, 0.05f, 0.99f, height, vec4(1, 1, 1, 1));
+  }
+
+  void game_over() {
+    printf("Thank you for playing!\7\7\7\n\n");
+  }
+};
+
+//
+// levels
+//
+
+// what brick mode plays when no level file is given: two blocks of three
+// bricks in each quarter of the court and a block sliding up and down the middle.
+inline void build_default_level(level_writer &writer) {
+  static const float brick_layout[][2] = {
+    //Upper left
+    { -0.30f, 0.8f }, { -0.15f, 0.8f }, { -0.15f, 0.45f },
+    //Upper right
+    { 0.15f, 0.8f }, { 0.30f, 0.8f }, { 0.15f, 0.45f },
+    //lower left
+    { -0.15f, -0.45f }, { -0.30f, -0.8f }, { -0.15f, -0.8f },
+    //lower right
+    { 0.15f, -0.45f }, { 0.15f, -0.8f }, { 0.30f, -0.8f },
+  };
+  float brick_hx = 0.05f;
+  float brick_hy = 0.15f;
+  for (unsigned i = 0; i != sizeof(brick_layout) / sizeof(brick_layout[0]); ++i) {
+    writer.add_brick(brick_layout[i][0], brick_layout[i][1], brick_hx, brick_hy);
+  }
+
+  float obstacle_hx = 0.05f;
+  float obstacle_hy = 0.3f;
+  writer.add_obstacle(obstacle_hx, obstacle_hy, 0.01f, 0.02f);
+  writer.add_path_point(0, 1 - obstacle_hy);
+  writer.add_path_point(0, obstacle_hy - 1);
+}
+
+// a wall of about num_bricks small bricks between the bats and num_obstacles
+// spinning blocks circling the court, for stress testing
+inline void build_brick_wall_level(level_writer &writer, unsigned num_bricks, unsigned num_obstacles) {
+  for (unsigned i = 0; i != num_obstacles; ++i) {
+    float radius = 0.2f + 0.6f * (i + 1) / (num_obstacles + 1);
+    float phase = i * 2.4f;
+    writer.add_obstacle(0.01f, 0.06f, 0.004f + 0.002f * (i % 4), i & 1 ? 0.05f : -0.03f);
+    for (int p = 0; p != 8; ++p) {
+      float angle = phase + p * (3.14159265f / 4);
+      writer.add_path_point(cosf(angle) * radius, sinf(angle) * radius);
+    }
+  }
+
+  float x0 = -0.8f, x1 = 0.8f, y0 = -0.95f, y1 = 0.95f;
+  unsigned columns = (unsigned)ceilf(sqrtf(num_bricks * (x1 - x0) / (y1 - y0)));
+  columns = columns ? columns : 1;
+  unsigned rows = (num_bricks + columns - 1) / columns;
+  float pitch_x = (x1 - x0) / columns;
+  float pitch_y = (y1 - y0) / (rows ? rows : 1);
+  for (unsigned i = 0; i != num_bricks; ++i) {
+    unsigned col = i % columns, row = i / columns;
+    unsigned rgba = 0xff000000 | (0x40 + (row * 37 & 0xbf)) << 16 | (0x40 + (col * 53 & 0xbf)) << 8 | 0xff;
+    writer.add_brick(x0 + (col + 0.5f) * pitch_x, y0 + (row + 0.5f) * pitch_y, pitch_x * 0.4f, pitch_y * 0.4f, rgba);
+  }
+}
+
+// the level being played: whatever main() mapped, or the default level
+inline level_file &current_level() {
+  level_file &level = level_file::get();
+  if (!level.loaded()) {
+    level_writer writer;
+    build_default_level(writer);
+    std::vector<unsigned char> image = writer.build();
+    level.use_memory(image);
+  }
+  return level;
+}
+
+//
+// obstacle behaviour
+//
+
+class no_obstacle {
+public:
+  void init(world &w, script_runner &scripts) {}
+};
+
+// the obstacles of the current level, each one following its path
+class level_obstacles {
+  // head for each point of the path in turn, round and round
+  script follow_path(world &w, entity_id obstacle, const level_obstacle *o) {
+    const float *path_x = current_level().path_x() + o->first_point;
+    const float *path_y = current_level().path_y() + o->first_point;
+
+    if (o->num_points < 2) {
+      co_return;
+    }
+    for (unsigned i = 0;; i = i + 1 == o->num_points ? 0 : i + 1) {
+      vec4 target(path_x[i], path_y[i], 0, 1);
+      for (;;) {
+        // components can move between ticks, so look them up each time
+        vec4 &pos = w.get<vec4>(obstacle, component_position);
+        vec4 &velocity = w.get<vec4>(obstacle, component_velocity);
+        vec4 diff = (target - pos).xyz();
+        float distance = diff.length();
+        if (distance <= o->speed) {
+          pos = target;
+          velocity = vec4(0, 0, 0, 0);
+          co_await next_tick();
+          break;
+        }
+        velocity = diff * (o->speed / distance);
+        co_await next_tick();
+      }
+    }
+  }
+public:
+  void init(world &w, script_runner &scripts) {
+    const level_file &level = current_level();
+    // level obstacles can rotate, so they collide as oriented boxes
+    component_mask mask =
+      component_bit(tag_obstacle) | component_bit(component_velocity) |
+      component_bit(component_rotation) | component_bit(component_spin)
+    ;
+    for (unsigned i = 0; i != level.num_obstacles(); ++i) {
+      const level_obstacle *o = level.obstacles() + i;
+      float x = o->num_points ? level.path_x()[o->first_point] : 0;
+      float y = o->num_points ? level.path_y()[o->first_point] : 0;
+      entity_id e = spawn_box(w, mask, x, y, o->hx, o->hy);
+      w.get<vec4>(e, component_velocity) = vec4(0, 0, 0, 0);
+      w.get<vec4>(e, component_rotation) = quat(0, 0, 0, 1);
+      w.get<vec4>(e, component_spin) = quat(0, 0, sinf(o->spin * 0.5f), cosf(o->spin * 0.5f));
+      scripts.spawn(follow_path(w, e, o));
+    }
+  }
+};
+
+//
+// brick layouts
+//
+
+class no_bricks {
+public:
+  void init(world &w) {}
+  void reset(world &w) {}
+  void collide(vec4 &ball_pos, vec4 &ball_vel, const vec4 &ball_half, particle_system &particles) {}
+  void snapshot(std::vector<unsigned> &alive) {}
+  void draw(instanced_boxes &instances, const std::vector<unsigned> &alive) {}
+  void extract(render_list &list, const std::vector<unsigned> &alive) {}
+};
+
+// the bricks of the current level, used in place from the level file.
+// the only per brick state is one 'alive' bit. The simulation copies the
+// bits into each snapshot, and drawing works from the snapshot's copy.
+class level_bricks {
+  const level_file *level_;
+  std::vector<unsigned> alive_;
+  brick_mesh mesh_;
+
+  static bool bit(const std::vector<unsigned> &bits, unsigned i) { return (bits[i >> 5] >> (i & 31)) & 1; }
+  bool alive(unsigned i) const { return bit(alive_, i); }
+  void kill(unsigned i) { alive_[i >> 5] &= ~(1u << (i & 31)); }
+public:
+  void init(world &w) {
+    level_ = &current_level();
+    mesh_.init(*level_);
+    reset(w);
+  }
+
+  // put back every brick that was knocked out
+  void reset(world &w) {
+    alive_.assign((level_->num_bricks() + 31) / 32, ~0u);
+  }
+
+  // knock out every brick the ball touches, looking only in the grid cells it
+  // covers, in a burst of its own color
+  void collide(vec4 &ball_pos, vec4 &ball_vel, const vec4 &ball_half, particle_system &particles) {
+    const float *cx = level_->brick_cx(), *cy = level_->brick_cy();
+    const float *hx = level_->brick_hx(), *hy = level_->brick_hy();
+    const unsigned *color = level_->brick_color();
+    const unsigned *cell_start = level_->cell_start();
+    const unsigned *cell_bricks = level_->cell_bricks();
+    unsigned grid_w = level_->header().grid_w;
+
+    int x0, y0, x1, y1;
+    level_->cell_range(
+      ball_pos[0] - ball_half[0], ball_pos[1] - ball_half[1],
+      ball_pos[0] + ball_half[0], ball_pos[1] + ball_half[1],
+      x0, y0, x1, y1
+    );
+    for (int y = y0; y <= y1; ++y) {
+      for (int x = x0; x <= x1; ++x) {
+        unsigned cell = y * grid_w + x;
+        for (unsigned r = cell_start[cell]; r != cell_start[cell + 1]; ++r) {
+          unsigned i = cell_bricks[r];
+          if (
+            alive(i) &&
+            fabsf(cx[i] - ball_pos[0]) < hx[i] + ball_half[0] &&
+            fabsf(cy[i] - ball_pos[1]) < hy[i] + ball_half[1]
+          ) {
+            kill(i);
+            particles.emit(vec4(cx[i], cy[i], 0, 1), 64, 0.8f, color[i], 0.8f);
+            bounce_off_box(ball_pos, ball_vel, ball_half, vec4(cx[i], cy[i], 0, 1), vec4(hx[i], hy[i], 0, 0));
+          }
+        }
+      }
+    }
+  }
+
+  // copy the alive bits for the renderer
+  void snapshot(std::vector<unsigned> &alive) {
+    alive = alive_;
+  }
+
+  // draw from the retained mesh: only chunks that lost a brick are rebuilt.
+  // a snapshot with no bits has not been filled in yet.
+  void draw(instanced_boxes &instances, const std::vector<unsigned> &alive) {
+    if (alive.size()) mesh_.draw(instances, alive.data());
+  }
+
+  // render extraction for the bricks still standing, without instancing
+  void extract(render_list &list, const std::vector<unsigned> &alive) {
+    if (!alive.size()) return;
+    const float *cx = level_->brick_cx(), *cy = level_->brick_cy();
+    const float *hx = level_->brick_hx(), *hy = level_->brick_hy();
+    const unsigned *color = level_->brick_color();
+    float scale = 1.0f / 255;
+    for (unsigned i = 0, n = level_->num_bricks(); i != n; ++i) {
+      if (bit(alive, i)) {
+        unsigned c = color[i];
+        vec4 rgba((c & 0xff) * scale, (c >> 8 & 0xff) * scale, (c >> 16 & 0xff) * scale, (c >> 24) * scale);
+        list.push(vec4(cx[i], cy[i], 0, 1), vec4(hx[i], hy[i], 0, 0), rgba);
+      }
+    }
+  }
+};
+
+//
+// who moves the bats
+//
+
+// two players on one keyboard: w/s and o/l, either server presses space
+class two_humans {
+public:
+  void move_bats(world &w, entity_id bats[2], entity_id ball, bool playing, const char *keys, const bool *special) {
+    vec4 bat_up(0, 0.02f, 0, 0);
+    vec4 &left = w.get<vec4>(bats[0], component_velocity);
+    vec4 &right = w.get<vec4>(bats[1], component_velocity);
+    left = vec4(0, 0, 0, 0);
+    right = vec4(0, 0, 0, 0);
+    if (keys['w']) left += bat_up;
+    if (keys['s']) left -= bat_up;
+    if (keys['o']) right += bat_up;
+    if (keys['l']) right -= bat_up;
+  }
+
+  bool wants_serve(int server, const char *keys) { return keys[' '] != 0; }
+
+  // pause before the ball can be served
+  float serve_delay() { return 0; }
+
+  // vertical speed of a serve in multiples of the ball speed
+  float serve_slope() { return -1.0f; }
+};
+
+// fixed by headless runs so that every serve is the same
+unsigned serve_seed = 0;
+
+// arrow keys against a bat that follows the ball and serves at once
+class human_vs_ai {
+  float random_n;
+public:
+  human_vs_ai() { random_n = 1; }
+
+  void move_bats(world &w, entity_id bats[2], entity_id ball, bool playing, const char *keys, const bool *special) {
+    // look at the keys and move the bats
+    vec4 bat_up(0, 0.02f, 0, 0);
+    vec4 pos = w.get<vec4>(bats[0], component_position);
+    vec4 half = w.get<vec4>(bats[0], component_extent);
+    vec4 &bat_velocity = w.get<vec4>(bats[0], component_velocity);
+    bat_velocity = vec4(0, 0, 0, 0);
+
+    if (special[GLUT_KEY_UP] && pos[1] + half[1] <= 1) {	// test for key and paddle within viewport
+      bat_velocity += bat_up;
+    }
+    if (special[GLUT_KEY_DOWN] && pos[1] - half[1] >= -1) {
+      bat_velocity -= bat_up;
+    }
+
+    // Opponent AI: follow the ball
+    vec4 bat_ai = vec4(0, 0.02f, 0, 0);
+    vec4 ai_pos = w.get<vec4>(bats[1], component_position);
+    vec4 ai_half = w.get<vec4>(bats[1], component_extent);
+    vec4 &ai_velocity = w.get<vec4>(bats[1], component_velocity);
+    ai_velocity = vec4(0, 0, 0, 0);
+
+    if (!playing) {
+      return;
+    }
+    float ball_y = w.get<vec4>(ball, component_position)[1];
+    if (ball_y >= ai_pos[1] && ai_pos[1] + ai_half[1] <= 1) {
+      ai_velocity += bat_ai;
+    }
+    if (ball_y <= ai_pos[1] && ai_pos[1] - ai_half[1] >= -1) {
+      ai_velocity -= bat_ai;
+    }
+  }
+
+  bool wants_serve(int server, const char *keys) { return server == 1 || keys[' ']; }
+
+  // give the player a moment to see the AI's serve coming
+  float serve_delay() { return 0.5f; }
+
+  float serve_slope() {
+    srand(serve_seed ? serve_seed : static_cast<unsigned int>(time(0)));				//seed random number
+    int lowest = -2;
+    int highest = 2;
+    int range;
+    range = (highest - lowest) + 1;
+    for(int index = 0; index < 20; index++) {
+      random_n = lowest + int(range * rand()/(RAND_MAX + 1.0));
+      if (random_n == 0.0f){
+        random_n += 1.0f;
+      }
+    }
+    return -random_n;
+  }
+};
+
+//
+// court size and look
+//
+
+class small_court {
+public:
+  float court_size() { return 0.6f; }
+  float ball_size() { return 0.03f; }
+  vec4 clear_color() { return vec4(0, 0, 1, 1); }
+  enum { textured_background = 0 };
+};
+
+class full_court {
+public:
+  float court_size() { return 0.98f; }
+  float ball_size() { return 0.02f; }
+  vec4 clear_color() { return vec4(0, 0, 0, 1); }
+  enum { textured_background = 1 };
+};
+
+//
+// the modes
+//
+
+// classic pong (was main.cpp)
+struct classic_rules {
+  typedef first_to_eleven scoring;
+  typedef no_obstacle obstacle;
+  typedef no_bricks bricks;
+  typedef two_humans players;
+  typedef small_court court;
+
+  static const char *title() { return "new pong"; }
+};
+
+// AI opponent, moving obstacle and bricks (was my_pong.cpp)
+struct brick_rules {
+  typedef first_to_six scoring;
+  typedef level_obstacles obstacle;
+  typedef level_bricks bricks;
+  typedef human_vs_ai players;
+  typedef full_court court;
+
+  static const char *title() { return "James Gamlin's Pong"; }
+};
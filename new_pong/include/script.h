@@ -0,0 +1,224 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// coroutine scripts
+//
+// A script is a C++20 coroutine that runs gameplay as straight-line code:
+//
+//   script patrol() {
+//     for (;;) {
+//       while (!at_top()) { move_up(); co_await next_tick(); }
+//       co_await seconds(0.5f);
+//     }
+//   }
+//
+// Scripts are spawned on a script_runner which resumes them once per
+// simulation tick. Sleeping scripts sit in a timing wheel slot for their
+// wake tick, so they cost nothing until they are due. Coroutine frames come from
+// script_frame_pool rather than the general heap.
+//
+
+// fixed size blocks for coroutine frames, one free list per size class
+class script_frame_pool {
+  enum {
+    min_shift = 6,          // smallest block is 64 bytes
+    num_classes = 5,        // ... biggest is 1024 bytes
+    chunk_size = 64 * 1024, // blocks are carved out of chunks this big
+    max_chunks = 256,
+  };
+
+  struct block { block *next; };
+
+  block *free_[num_classes];
+  void *chunks_[max_chunks];
+  unsigned num_chunks_;
+
+  static int size_class(size_t size) {
+    int c = 0;
+    while (c != num_classes && ((size_t)1 << (c + min_shift)) < size) ++c;
+    return c;
+  }
+
+  void refill(int c) {
+    size_t bytes = (size_t)1 << (c + min_shift);
+    char *chunk = (char*)malloc(chunk_size);
+    assert(num_chunks_ != max_chunks);
+    chunks_[num_chunks_++] = chunk;
+    for (size_t offset = 0; offset + bytes <= chunk_size; offset += bytes) {
+      block *b = (block*)(chunk + offset);
+      b->next = free_[c];
+      free_[c] = b;
+    }
+  }
+
+  script_frame_pool() {
+    memset(free_, 0, sizeof(free_));
+    num_chunks_ = 0;
+  }
+
+  ~script_frame_pool() {
+    for (unsigned i = 0; i != num_chunks_; ++i) {
+      free(chunks_[i]);
+    }
+  }
+public:
+  void *allocate(size_t size) {
+    int c = size_class(size);
+    if (c == num_classes) {
+      // too big for the pool
+      return malloc(size);
+    }
+    if (!free_[c]) refill(c);
+    block *b = free_[c];
+    free_[c] = b->next;
+    return b;
+  }
+
+  void deallocate(void *p, size_t size) {
+    int c = size_class(size);
+    if (c == num_classes) {
+      free(p);
+      return;
+    }
+    block *b = (block*)p;
+    b->next = free_[c];
+    free_[c] = b;
+  }
+
+  static script_frame_pool &get() {
+    static script_frame_pool the_pool;
+    return the_pool;
+  }
+};
+
+class script_runner;
+
+// the return type of every script coroutine
+class script {
+public:
+  struct promise_type {
+    script_runner *runner;
+
+    promise_type() { runner = 0; }
+
+    static void *operator new(size_t size) { return script_frame_pool::get().allocate(size); }
+    static void operator delete(void *p, size_t size) { script_frame_pool::get().deallocate(p, size); }
+
+    script get_return_object() { return script(std::coroutine_handle<promise_type>::from_promise(*this)); }
+
+    // scripts start when they are spawned and stay alive until the runner destroys them
+    std::suspend_always initial_suspend() noexcept { return std::suspend_always(); }
+    std::suspend_always final_suspend() noexcept { return std::suspend_always(); }
+    void return_void() {}
+    void unhandled_exception() { abort(); }
+  };
+
+  typedef std::coroutine_handle<promise_type> handle_t;
+
+  explicit script(handle_t h) { handle_ = h; }
+  script(script &&rhs) { handle_ = rhs.handle_; rhs.handle_ = handle_t(); }
+  ~script() { if (handle_) handle_.destroy(); }
+
+  // hand the coroutine to a runner
+  handle_t release() { handle_t h = handle_; handle_ = handle_t(); return h; }
+
+private:
+  script(const script &);
+  script &operator=(const script &);
+
+  handle_t handle_;
+};
+
+// resumes scripts when their wake tick comes round
+class script_runner {
+  enum { wheel_size = 256 };   // must be a power of two
+
+  struct sleeper {
+    unsigned wake;
+    script::handle_t handle;
+  };
+
+  // a timing wheel: a script sleeping until tick t waits in slot t % wheel_size.
+  // longer sleeps go round the wheel more than once.
+  std::vector<sleeper> wheel_[wheel_size];
+  std::vector<sleeper> due_;
+  unsigned now_;
+  float tick_seconds_;
+
+  void resume(script::handle_t h) {
+    h.resume();
+    if (h.done()) {
+      h.destroy();
+    }
+  }
+public:
+  script_runner() {
+    now_ = 0;
+    tick_seconds_ = 0.03f;
+  }
+
+  ~script_runner() {
+    for (int i = 0; i != wheel_size; ++i) {
+      for (size_t j = 0; j != wheel_[i].size(); ++j) {
+        wheel_[i][j].handle.destroy();
+      }
+    }
+  }
+
+  // length of one simulation tick, used by seconds()
+  void set_tick_seconds(float t) { tick_seconds_ = t; }
+  float tick_seconds() const { return tick_seconds_; }
+  unsigned now() const { return now_; }
+
+  // start a script: it runs until its first co_await
+  void spawn(script s) {
+    script::handle_t h = s.release();
+    h.promise().runner = this;
+    resume(h);
+  }
+
+  // called by the awaitables
+  void sleep(script::handle_t h, unsigned ticks) {
+    sleeper s = { now_ + ticks, h };
+    wheel_[s.wake & (wheel_size - 1)].push_back(s);
+  }
+
+  // advance one simulation tick and resume every script that is due,
+  // in the order they went to sleep.
+  void tick() {
+    ++now_;
+    std::vector<sleeper> &slot = wheel_[now_ & (wheel_size - 1)];
+    if (slot.empty()) return;
+
+    // scripts may sleep straight back into this slot, so work from a copy
+    due_.swap(slot);
+    for (size_t i = 0; i != due_.size(); ++i) {
+      if (due_[i].wake == now_) {
+        resume(due_[i].handle);
+      } else {
+        slot.push_back(due_[i]);
+      }
+    }
+    due_.clear();
+  }
+};
+
+// co_await next_tick(): carry on at the next simulation tick
+struct next_tick {
+  bool await_ready() const { return false; }
+  void await_suspend(script::handle_t h) const { h.promise().runner->sleep(h, 1); }
+  void await_resume() const {}
+};
+
+// co_await seconds(x): carry on after x seconds of simulation time
+struct seconds {
+  float duration;
+
+  explicit seconds(float d) { duration = d; }
+  bool await_ready() const { return duration <= 0; }
+  void await_suspend(script::handle_t h) const {
+    script_runner *runner = h.promise().runner;
+    unsigned ticks = (unsigned)ceilf(duration / runner->tick_seconds());
+    runner->sleep(h, ticks ? ticks : 1);
+  }
+  void await_resume() const {}
+};
@@ -1,49 +1,308 @@
-class shader {
-  GLuint program_;
-  GLuint emissive_colorIndex_;
-public:
-  shader() {}
-  
-  void init(const char *vs, const char *fs) {
-    bool debug = true;
-    GLsizei length;
-    GLchar buf[256];
-
-    // create our vertex shader and compile it
-    GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &vs, NULL);
-    glCompileShader(vertex_shader);
-    glGetShaderInfoLog(vertex_shader, sizeof(buf), &length, buf);
-    puts(buf);
-    
-    // create our fragment shader and compile it
-    GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &fs, NULL);
-    glCompileShader(fragment_shader);
-    glGetShaderInfoLog(fragment_shader, sizeof(buf), &length, buf);
-    puts(buf);
-
-    // assemble the program for use by glUseProgram
-    GLuint program = glCreateProgram();
-    glAttachShader(program, vertex_shader);
-    glAttachShader(program, fragment_shader);
-    
-    // pos and normal are always 0 and 1
-    glBindAttribLocation(program, 0, "pos");
-    glBindAttribLocation(program, 1, "normal");
-    glLinkProgram(program);
-    program_ = program;
-    glGetProgramInfoLog(program, sizeof(buf), &length, buf);
-    puts(buf);
-    
-    emissive_colorIndex_ = glGetUniformLocation(program, "emissive_color");
-    if( debug ) printf("emissive_colorIndex_=%d\n", emissive_colorIndex_);
-  }
-  
-  // set the uniforms
-  void render(const vec4 &emissive_color) {
-    glUseProgram(program_);
-
-    glUniform4fv(emissive_colorIndex_, 1, emissive_color.get());
-  }
-};
+////////////////////////////////////////////////////////////////////////////////
+//
+// shader programs
+//
+// One shader class for everything. After linking it reflects the active
+// attributes and uniforms into small tables: uniforms are set by name, and
+// sampler uniforms get texture units in the order they are declared, set once.
+//
+// Attributes have fixed locations (vertex_attrib), bound before every program
+// links, so a vertex array object can be set up once for any shader that
+// reads the same names.
+//
+// Shaders are written in the ES2 style (attribute, varying, texture2D,
+// gl_FragColor). In a core profile context they are translated to GLSL 3.30
+// word by word before compiling.
+//
+// Data that changes per frame rather than per draw lives in frame_uniforms.
+// It is declared ahead of every shader's own source, and every shader reads
+// the same std140 uniform block, uploaded once a frame. Drivers without uniform
+// buffers get plain uniforms, set once a frame in each shader that is used.
+//
+
+// the location of every attribute any shader reads
+enum vertex_attrib {
+  attrib_pos,
+  attrib_uv,
+  attrib_color,
+  attrib_box,
+  attrib_axis,
+  attrib_px,
+  attrib_py,
+  attrib_life,
+  num_vertex_attribs
+};
+
+// the names, in vertex_attrib order
+inline const char *const *vertex_attrib_names() {
+  static const char *const names[num_vertex_attribs] = {
+    "pos", "uv", "color", "box", "axis", "px", "py", "life"
+  };
+  return names;
+}
+
+// the per-frame data, in std140 layout
+struct frame_uniforms {
+  mat4 view_proj;     // as glUniformMatrix4fv(..., GL_FALSE, view_proj.get())
+  vec4 params;        // time in seconds, 1/width, 1/height, 0
+};
+
+class frame_uniform_buffer {
+  frame_uniforms data_;
+  unsigned version_;
+  bool initialised_;
+  bool supported_;
+  GLint align_;
+
+  frame_uniform_buffer() {
+    data_.view_proj.loadIdentity();
+    data_.params = vec4(0, 0, 0, 0);
+    version_ = 1;
+    initialised_ = supported_ = false;
+    align_ = 16;
+  }
+public:
+  enum { binding = 0 };
+
+  bool supported() {
+    if (!initialised_) {
+      initialised_ = true;
+      supported_ = gl_version_at_least(3, 1) || gl_has_extension("GL_ARB_uniform_buffer_object");
+      if (supported_) glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align_);
+    }
+    return supported_;
+  }
+
+  // the block every shader includes, before its own code
+  const char *declaration() {
+    if (gl_core_profile()) {
+      return
+        "#version 330 core\n"
+        "layout(std140) uniform frame_block { mat4 view_proj; vec4 frame_params; };\n"
+      ;
+    }
+    return supported() ?
+      "#version 140\n"
+      "layout(std140) uniform frame_block { mat4 view_proj; vec4 frame_params; };\n" :
+      "#version 110\n"
+      "uniform mat4 view_proj; uniform vec4 frame_params;\n"
+    ;
+  }
+
+  // fill this in, then upload() once a frame
+  frame_uniforms &data() { return data_; }
+  unsigned version() const { return version_; }
+
+  void upload(gpu_ring &ring) {
+    version_++;
+    if (!supported()) return;
+    void *dest = ring.reserve(sizeof(data_), align_);
+    memcpy(dest, &data_, sizeof(data_));
+    GLintptr offset = ring.commit(sizeof(data_));
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, ring.buffer(), offset, sizeof(data_));
+    render_stats::get().state_call(true);
+  }
+
+  static frame_uniform_buffer &get() {
+    static frame_uniform_buffer the_buffer;
+    return the_buffer;
+  }
+};
+
+class shader {
+  enum {
+    max_uniforms = 16,
+    max_attribs = 16,
+    max_name = 64,
+  };
+
+  struct uniform_info {
+    unsigned hash;
+    GLint location;
+  };
+
+  struct attrib_info {
+    unsigned hash;
+    GLint location;
+  };
+
+  uniform_info uniforms_[max_uniforms];
+  attrib_info attribs_[max_attribs];
+  unsigned num_uniforms_;
+  unsigned num_attribs_;
+
+  shader_request request_;
+  char *vs_, *fs_;
+  bool pending_;
+  GLuint program_;
+
+  // for drivers without uniform buffers
+  unsigned frame_version_;
+  GLint view_proj_index_;
+  GLint frame_params_index_;
+
+  static unsigned name_hash(const char *name, size_t length) {
+    unsigned h = 2166136261u;
+    for (size_t i = 0; i != length && name[i]; ++i) {
+      h = (h ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return h;
+  }
+
+  static char *join(const char *a, const char *b) {
+    size_t la = strlen(a), lb = strlen(b);
+    char *result = (char*)malloc(la + lb + 1);
+    memcpy(result, a, la);
+    memcpy(result + la, b, lb + 1);
+    return result;
+  }
+
+  static bool ident_char(char c) {
+    return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+  }
+
+  // frame followed by an ES2 style source rewritten for GLSL 3.30 core.
+  // every replacement is shorter than the word it replaces.
+  static char *join_core(const char *frame, const char *src, bool vertex) {
+    const char *output = vertex ? "" : "out vec4 frag_color;\n";
+    size_t lf = strlen(frame), lo = strlen(output);
+    char *result = (char*)malloc(lf + lo + strlen(src) + 1);
+    memcpy(result, frame, lf);
+    memcpy(result + lf, output, lo);
+    char *dest = result + lf + lo;
+
+    for (const char *p = src; *p; ) {
+      if (!ident_char(*p)) { *dest++ = *p++; continue; }
+      const char *end = p;
+      while (ident_char(*end)) ++end;
+      size_t len = end - p;
+      const char *word = 0;
+      if (len == 9 && !memcmp(p, "attribute", 9)) word = "in";
+      else if (len == 7 && !memcmp(p, "varying", 7)) word = vertex ? "out" : "in";
+      else if (len == 9 && !memcmp(p, "texture2D", 9)) word = "texture";
+      else if (len == 12 && !memcmp(p, "gl_FragColor", 12)) word = "frag_color";
+      if (word) {
+        len = strlen(word);
+        memcpy(dest, word, len);
+      } else {
+        memcpy(dest, p, len);
+      }
+      dest += len;
+      p = end;
+    }
+    *dest = 0;
+    return result;
+  }
+
+  void reflect() {
+    GLchar name[max_name];
+    GLsizei length;
+    GLint size;
+    GLenum type;
+
+    // uniforms: samplers take the next texture unit
+    GLint count = 0, unit = 0;
+    glGetProgramiv(program_, GL_ACTIVE_UNIFORMS, &count);
+    gl_state::get().use_program(program_);
+    for (GLint i = 0; i != count; ++i) {
+      glGetActiveUniform(program_, i, sizeof(name), &length, &size, &type, name);
+      GLint location = glGetUniformLocation(program_, name);
+      if (location < 0 || num_uniforms_ == max_uniforms) continue;   // in a block, or too many
+
+      // arrays are reported as "name[0]"
+      const char *bracket = strchr(name, '[');
+      uniform_info &u = uniforms_[num_uniforms_++];
+      u.hash = name_hash(name, bracket ? bracket - name : length);
+      u.location = location;
+      if (type == GL_SAMPLER_2D) glUniform1i(location, unit++);
+    }
+
+    count = 0;
+    glGetProgramiv(program_, GL_ACTIVE_ATTRIBUTES, &count);
+    for (GLint i = 0; i != count && num_attribs_ != max_attribs; ++i) {
+      glGetActiveAttrib(program_, i, sizeof(name), &length, &size, &type, name);
+      attrib_info &a = attribs_[num_attribs_++];
+      a.hash = name_hash(name, length);
+      a.location = glGetAttribLocation(program_, name);
+    }
+
+    GLuint block = frame_uniform_buffer::get().supported() ? glGetUniformBlockIndex(program_, "frame_block") : GL_INVALID_INDEX;
+    if (block != GL_INVALID_INDEX) {
+      glUniformBlockBinding(program_, block, frame_uniform_buffer::binding);
+    }
+    view_proj_index_ = uniform("view_proj");
+    frame_params_index_ = uniform("frame_params");
+  }
+
+public:
+  shader() {
+    num_uniforms_ = num_attribs_ = 0;
+    vs_ = fs_ = 0;
+    pending_ = false;
+    program_ = 0;
+    frame_version_ = 0;
+  }
+
+  // start compiling: the program is finished on first use.
+  // view_proj and frame_params are declared ahead of the sources.
+  void init(const char *vs, const char *fs) {
+    const char *frame = frame_uniform_buffer::get().declaration();
+    if (gl_core_profile()) {
+      vs_ = join_core(frame, vs, true);
+      fs_ = join_core(frame, fs, false);
+    } else {
+      vs_ = join(frame, vs);
+      fs_ = join(frame, fs);
+    }
+    request_ = shader_pipeline::get().start(vs_, fs_, vertex_attrib_names(), num_vertex_attribs);
+    program_ = request_.program;
+    pending_ = true;
+  }
+
+  void finish() {
+    if (!pending_) return;
+    pending_ = false;
+    shader_pipeline::get().finish(request_);
+    program_ = request_.program;
+    free(vs_);
+    free(fs_);
+    vs_ = fs_ = 0;
+    reflect();
+  }
+
+  // location of an active uniform or attribute, -1 if there is none
+  GLint uniform(const char *name) const {
+    unsigned h = name_hash(name, max_name);
+    for (unsigned i = 0; i != num_uniforms_; ++i) {
+      if (uniforms_[i].hash == h) return uniforms_[i].location;
+    }
+    return -1;
+  }
+
+  GLint attrib(const char *name) const {
+    unsigned h = name_hash(name, max_name);
+    for (unsigned i = 0; i != num_attribs_; ++i) {
+      if (attribs_[i].hash == h) return attribs_[i].location;
+    }
+    return -1;
+  }
+
+  // bind the program for drawing
+  void use() {
+    finish();
+    gl_state::get().use_program(program_);
+
+    frame_uniform_buffer &frame = frame_uniform_buffer::get();
+    if (!frame.supported() && frame_version_ != frame.version()) {
+      frame_version_ = frame.version();
+      glUniformMatrix4fv(view_proj_index_, 1, GL_FALSE, frame.data().view_proj.get());
+      glUniform4fv(frame_params_index_, 1, frame.data().params.get());
+    }
+  }
+
+  // per-draw uniforms, for the program in use
+  void set(const char *name, const vec4 &value) { glUniform4fv(uniform(name), 1, value.get()); }
+  void set(const char *name, const mat4 &value) { glUniformMatrix4fv(uniform(name), 1, GL_FALSE, value.get()); }
+  void set(const char *name, float value) { glUniform1f(uniform(name), value); }
+  void set(const char *name, int value) { glUniform1i(uniform(name), value); }
+};
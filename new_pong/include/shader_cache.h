@@ -0,0 +1,237 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// shader pipeline
+//
+// Programs are started early and finished when first used:
+//
+//   shader_request r = shader_pipeline::get().start(vs, fs, attribs, num_attribs);
+//   ...                         // the driver compiles in the background
+//   shader_pipeline::get().finish(r);
+//
+// start() never asks GL for a status, so with KHR_parallel_shader_compile
+// every program of a scene compiles at once on the driver's threads.
+// finish() checks the link status and prints the info logs only when
+// something failed.
+//
+// Linked programs are saved with glGetProgramBinary in shader_cache/, in a
+// file named for a hash of the sources, the attribute bindings and the
+// driver's vendor, renderer and version strings. A warm start loads the
+// binary and compiles nothing. A binary that no longer loads is simply
+// compiled again.
+//
+
+// a program on its way through the pipeline
+struct shader_request {
+  GLuint program;
+  GLuint vertex_shader;       // 0 when the program came from the cache
+  GLuint fragment_shader;
+  unsigned long long key;
+  const char *vs, *fs;
+  const char *const *attribs;
+  unsigned num_attribs;
+};
+
+class shader_pipeline {
+  // the head of a cache file
+  struct binary_header {
+    char magic[4];            // "PSHB"
+    GLenum format;
+    GLint length;
+  };
+
+  enum { max_binary = 1 << 24 };
+
+  bool initialised_;
+  bool binaries_;
+  unsigned long long driver_key_;
+  unsigned hits_, misses_;
+
+  static unsigned long long hash(unsigned long long h, const char *str) {
+    // FNV-1a, including the terminator so that "ab" "c" differs from "a" "bc"
+    for (const char *p = str ? str : ""; ; ++p) {
+      h = (h ^ (unsigned char)*p) * 0x100000001b3ull;
+      if (!*p) return h;
+    }
+  }
+
+  static const char *dir() { return "shader_cache"; }
+
+  void path(char *buf, size_t size, unsigned long long key) {
+    sprintf_s(buf, size, "%s/%016llx.bin", dir(), key);
+  }
+
+  void lazy_init() {
+    if (initialised_) return;
+    initialised_ = true;
+
+    if (gl_has_extension("GL_KHR_parallel_shader_compile") && gl_max_shader_compiler_threads()) {
+      gl_max_shader_compiler_threads()(0xffffffff);
+    }
+
+    GLint formats = 0;
+    if (gl_version_at_least(4, 1) || gl_has_extension("GL_ARB_get_program_binary")) {
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    }
+    binaries_ = formats > 0;
+    if (binaries_) {
+      #ifdef WIN32
+        CreateDirectoryA(dir(), NULL);
+      #else
+        mkdir(dir(), 0755);
+      #endif
+    }
+
+    unsigned long long h = 0xcbf29ce484222325ull;
+    h = hash(h, (const char*)glGetString(GL_VENDOR));
+    h = hash(h, (const char*)glGetString(GL_RENDERER));
+    h = hash(h, (const char*)glGetString(GL_VERSION));
+    driver_key_ = h;
+  }
+
+  bool load_binary(shader_request &r) {
+    char name[256];
+    path(name, sizeof(name), r.key);
+    FILE *file = fopen(name, "rb");
+    if (!file) return false;
+
+    binary_header header;
+    bool ok =
+      fread(&header, sizeof(header), 1, file) == 1 && !memcmp(header.magic, "PSHB", 4) &&
+      header.length > 0 && header.length <= max_binary
+    ;
+    char *data = ok ? (char*)malloc(header.length) : 0;
+    ok = ok && fread(data, header.length, 1, file) == 1;
+    fclose(file);
+    if (ok) {
+      r.program = glCreateProgram();
+      glProgramBinary(r.program, header.format, data, header.length);
+    }
+    free(data);
+    return ok;
+  }
+
+  void save_binary(const shader_request &r) {
+    binary_header header = { { 'P', 'S', 'H', 'B' }, 0, 0 };
+    glGetProgramiv(r.program, GL_PROGRAM_BINARY_LENGTH, &header.length);
+    if (header.length <= 0) return;
+    char *data = (char*)malloc(header.length);
+    glGetProgramBinary(r.program, header.length, &header.length, &header.format, data);
+
+    char name[256];
+    path(name, sizeof(name), r.key);
+    FILE *file = fopen(name, "wb");
+    if (file) {
+      fwrite(&header, sizeof(header), 1, file);
+      fwrite(data, header.length, 1, file);
+      fclose(file);
+    }
+    free(data);
+  }
+
+  void compile(shader_request &r) {
+    r.vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(r.vertex_shader, 1, &r.vs, NULL);
+    glCompileShader(r.vertex_shader);
+
+    r.fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(r.fragment_shader, 1, &r.fs, NULL);
+    glCompileShader(r.fragment_shader);
+
+    r.program = glCreateProgram();
+    glAttachShader(r.program, r.vertex_shader);
+    glAttachShader(r.program, r.fragment_shader);
+    for (unsigned i = 0; i != r.num_attribs; ++i) {
+      if (r.attribs[i]) glBindAttribLocation(r.program, i, r.attribs[i]);
+    }
+    if (binaries_) {
+      glProgramParameteri(r.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(r.program);
+  }
+
+  static void print_log(GLuint object, bool program) {
+    GLchar buf[1024];
+    GLsizei length = 0;
+    if (program) {
+      glGetProgramInfoLog(object, sizeof(buf), &length, buf);
+    } else {
+      glGetShaderInfoLog(object, sizeof(buf), &length, buf);
+    }
+    if (length) puts(buf);
+  }
+
+  shader_pipeline() {
+    initialised_ = binaries_ = false;
+    driver_key_ = 0;
+    hits_ = misses_ = 0;
+  }
+public:
+  // attribs[i] is bound to location i; null entries are skipped.
+  // the strings must live until finish().
+  shader_request start(const char *vs, const char *fs, const char *const *attribs, unsigned num_attribs) {
+    lazy_init();
+
+    shader_request r;
+    r.program = r.vertex_shader = r.fragment_shader = 0;
+    r.vs = vs;
+    r.fs = fs;
+    r.attribs = attribs;
+    r.num_attribs = num_attribs;
+
+    unsigned long long h = hash(driver_key_, vs);
+    h = hash(h, fs);
+    for (unsigned i = 0; i != num_attribs; ++i) {
+      h = hash(h, attribs[i]);
+    }
+    r.key = h;
+
+    if (binaries_ && load_binary(r)) {
+      hits_++;
+    } else {
+      misses_++;
+      compile(r);
+    }
+    return r;
+  }
+
+  // wait for the program to link; returns false (and prints why) if it failed
+  bool finish(shader_request &r) {
+    GLint linked = GL_FALSE;
+    glGetProgramiv(r.program, GL_LINK_STATUS, &linked);
+
+    if (!linked && !r.vertex_shader) {
+      // a stale binary: the driver changed in a way its strings did not show
+      glDeleteProgram(r.program);
+      hits_--;
+      misses_++;
+      compile(r);
+      glGetProgramiv(r.program, GL_LINK_STATUS, &linked);
+    }
+
+    if (!linked) {
+      print_log(r.vertex_shader, false);
+      print_log(r.fragment_shader, false);
+      print_log(r.program, true);
+    } else if (binaries_ && r.vertex_shader) {
+      save_binary(r);
+    }
+
+    if (r.vertex_shader) {
+      glDetachShader(r.program, r.vertex_shader);
+      glDetachShader(r.program, r.fragment_shader);
+      glDeleteShader(r.vertex_shader);
+      glDeleteShader(r.fragment_shader);
+      r.vertex_shader = r.fragment_shader = 0;
+    }
+    return linked != GL_FALSE;
+  }
+
+  // programs loaded from / missing from the cache
+  unsigned hits() const { return hits_; }
+  unsigned misses() const { return misses_; }
+
+  static shader_pipeline &get() {
+    static shader_pipeline the_pipeline;
+    return the_pipeline;
+  }
+};
@@ -0,0 +1,360 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// software rasterizer
+//
+// Draws the same quads as sprite_batch on the CPU, for machines with no GL.
+// Quads are binned into 64x64 pixel tiles as they arrive; at the end of the
+// frame a pool of worker threads takes tiles one at a time, clears them and
+// draws their quads in submission order, so no two threads ever touch the
+// same pixel. Spans are filled four pixels at a time with SSE2.
+//
+// Texels with less than half alpha are not drawn, like the sprite shader.
+//
+// Corners snap to 1/256 of a pixel and coverage is sampled at pixel centers
+// with GL's tie rules, and textures are sampled NEAREST, so the result
+// matches the GL renderer up to texel rounding.
+//
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+  #define SOFT_RASTER_USE_SSE 1
+#endif
+
+// RGBA8 pixels, top row first
+struct soft_texture {
+  const unsigned char *pixels;
+  int width, height;
+};
+
+class soft_rasterizer {
+  enum {
+    tile_shift = 6,
+    tile_size = 1 << tile_shift,
+    max_threads = 32,
+  };
+
+  // a quad in pixel space: corner p and edges ex, ey (a parallelogram)
+  struct soft_quad {
+    float px, py, exx, exy, eyx, eyy;
+    float u0, v0, dudx, dudy, dvdx, dvdy;  // uv at pixel (0, 0) and its gradients
+    int x0, y0, x1, y1;                    // bounding box, clipped
+    bool axis_aligned;                     // ...and then exactly the pixels covered
+    unsigned color;
+    const soft_texture *texture;
+  };
+
+  // the frame
+  std::vector<unsigned> pixels_;
+  int width_, height_;
+  int tiles_x_, tiles_y_;
+  unsigned clear_;
+
+  // quads and, for each tile, the quads that touch it
+  std::vector<soft_quad> quads_;
+  std::vector<std::vector<unsigned> > bins_;
+
+  // workers wait for a new generation, then take tiles until none are left
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_, done_;
+  unsigned generation_;
+  unsigned busy_;
+  std::atomic<unsigned> next_tile_;
+  bool quit_;
+
+  static unsigned pack(const vec4 &color) {
+    return
+      (unsigned)sprite_batch::to_byte(color[0]) |
+      (unsigned)sprite_batch::to_byte(color[1]) << 8 |
+      (unsigned)sprite_batch::to_byte(color[2]) << 16 |
+      (unsigned)sprite_batch::to_byte(color[3]) << 24
+    ;
+  }
+
+  static void fill(unsigned *dest, int count, unsigned color) {
+    int i = 0;
+    #if SOFT_RASTER_USE_SSE
+      __m128i c = _mm_set1_epi32((int)color);
+      for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i*)(dest + i), c);
+      }
+    #endif
+    for (; i < count; ++i) dest[i] = color;
+  }
+
+  // nearest texels along row y, four at a time
+  static void textured_span(const soft_quad &q, unsigned *row, int x0, int x1, int y) {
+    const soft_texture &t = *q.texture;
+    const unsigned *texels = (const unsigned*)t.pixels;
+    float u_row = q.u0 + q.dudy * (y + 0.5f);
+    float v_row = q.v0 + q.dvdy * (y + 0.5f);
+    float w = (float)t.width, h = (float)t.height;
+    int x = x0;
+    #if SOFT_RASTER_USE_SSE
+      __m128 du = _mm_set1_ps(q.dudx), dv = _mm_set1_ps(q.dvdx);
+      __m128 ur = _mm_set1_ps(u_row), vr = _mm_set1_ps(v_row);
+      __m128 vw = _mm_set1_ps(w), vh = _mm_set1_ps(h);
+      __m128 zero = _mm_setzero_ps();
+      __m128 max_u = _mm_set1_ps(w - 1), max_v = _mm_set1_ps(h - 1);
+      for (; x + 4 <= x1; x += 4) {
+        __m128 xc = _mm_add_ps(_mm_cvtepi32_ps(_mm_setr_epi32(x, x + 1, x + 2, x + 3)), _mm_set1_ps(0.5f));
+        __m128 u = _mm_mul_ps(_mm_add_ps(ur, _mm_mul_ps(du, xc)), vw);
+        __m128 v = _mm_mul_ps(_mm_add_ps(vr, _mm_mul_ps(dv, xc)), vh);
+        __m128i iu = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(u, zero), max_u));
+        __m128i iv = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(v, zero), max_v));
+        __m128 index = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(iv), vw), _mm_cvtepi32_ps(iu));
+        alignas(16) int i[4];
+        _mm_store_si128((__m128i*)i, _mm_cvttps_epi32(index));
+        for (int l = 0; l != 4; ++l) {
+          put(row[x + l], texels[i[l]], q.color);
+        }
+      }
+    #endif
+    for (; x != x1; ++x) {
+      float u = u_row + q.dudx * (x + 0.5f), v = v_row + q.dvdx * (x + 0.5f);
+      int iu = (int)floorf(u * w), iv = (int)floorf(v * h);
+      iu = iu < 0 ? 0 : iu >= t.width ? t.width - 1 : iu;
+      iv = iv < 0 ? 0 : iv >= t.height ? t.height - 1 : iv;
+      put(row[x], texels[iv * t.width + iu], q.color);
+    }
+  }
+
+  // one textured pixel, dropped when the sprite shader would discard it
+  static void put(unsigned &dest, unsigned texel, unsigned color) {
+    unsigned c = color == 0xffffffff ? texel : modulate(texel, color);
+    if (c >= 0x80000000u) dest = c;
+  }
+
+  // GPUs snap vertices to a grid of 1/256 pixel
+  static float snap(float f) {
+    return floorf(f * 256 + 0.5f) * (1.0f / 256);
+  }
+
+  // texel times color, rounded like the GPU
+  static unsigned modulate(unsigned texel, unsigned color) {
+    unsigned result = 0;
+    for (int shift = 0; shift != 32; shift += 8) {
+      unsigned t = (texel >> shift) & 0xff, c = (color >> shift) & 0xff;
+      result |= ((t * c + 127) / 255) << shift;
+    }
+    return result;
+  }
+
+  // the columns [x0, x1) of row y whose centers are inside the quad
+  static bool span(const soft_quad &q, float yc, int &x0, int &x1) {
+    // solve each pair of opposite edges for x: 0 <= (along the other edge) <= 1
+    float lo = -1e30f, hi = 1e30f;
+    float det = q.exx * q.eyy - q.exy * q.eyx;
+    if (det == 0) return false;
+    float dy = yc - q.py;
+
+    // s = ((x - px) * eyy - dy * eyx) / det, t = (dy * exx - (x - px) * exy) / det
+    float s_a = q.eyy / det, s_b = (-dy * q.eyx) / det - q.px * s_a;
+    float t_a = -q.exy / det, t_b = (dy * q.exx) / det - q.px * t_a;
+    float coefficients[2][2] = { { s_a, s_b }, { t_a, t_b } };
+    for (int i = 0; i != 2; ++i) {
+      float a = coefficients[i][0], b = coefficients[i][1];
+      if (a == 0) {
+        if (b < 0 || b >= 1) return false;
+      } else {
+        float r0 = (0 - b) / a, r1 = (1 - b) / a;
+        if (a < 0) { float tmp = r0; r0 = r1; r1 = tmp; }
+        lo = r0 > lo ? r0 : lo;
+        hi = r1 < hi ? r1 : hi;
+      }
+    }
+    x0 = (int)ceilf(lo - 0.5f);
+    x1 = (int)ceilf(hi - 0.5f);
+    return x0 < x1;
+  }
+
+  // draw one tile's quads into a buffer that stays in cache, then copy it
+  // to the frame: every pixel of the frame is written once
+  void draw_tile(unsigned tile) {
+    int tx = (int)(tile % tiles_x_) << tile_shift, ty = (int)(tile / tiles_x_) << tile_shift;
+    int tx1 = tx + tile_size < width_ ? tx + tile_size : width_;
+    int ty1 = ty + tile_size < height_ ? ty + tile_size : height_;
+    alignas(16) unsigned buffer[tile_size * tile_size];
+    fill(buffer, tile_size * tile_size, clear_);
+
+    const std::vector<unsigned> &bin = bins_[tile];
+    for (size_t i = 0; i != bin.size(); ++i) {
+      const soft_quad &q = quads_[bin[i]];
+      int y0 = q.y0 > ty ? q.y0 : ty, y1 = q.y1 < ty1 ? q.y1 : ty1;
+      for (int y = y0; y < y1; ++y) {
+        int x0 = q.x0, x1 = q.x1;
+        if (!q.axis_aligned && !span(q, y + 0.5f, x0, x1)) continue;
+        x0 = x0 > tx ? x0 : tx;
+        x1 = x1 < tx1 ? x1 : tx1;
+        if (x0 >= x1) continue;
+        unsigned *row = buffer + ((y - ty) << tile_shift) - tx;
+        if (q.texture) {
+          textured_span(q, row, x0, x1, y);
+        } else {
+          fill(row + x0, x1 - x0, q.color);
+        }
+      }
+    }
+
+    for (int y = ty; y != ty1; ++y) {
+      memcpy(&pixels_[(size_t)y * width_ + tx], buffer + ((y - ty) << tile_shift), (tx1 - tx) * sizeof(unsigned));
+    }
+  }
+
+  void work() {
+    for (unsigned tile; (tile = next_tile_.fetch_add(1)) < bins_.size(); ) {
+      draw_tile(tile);
+    }
+  }
+
+  void worker() {
+    unsigned seen = 0;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_.wait(lock, [&] { return quit_ || generation_ != seen; });
+        if (quit_) return;
+        seen = generation_;
+      }
+      work();
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--busy_ == 0) done_.notify_one();
+    }
+  }
+
+public:
+  soft_rasterizer() {
+    width_ = height_ = tiles_x_ = tiles_y_ = 0;
+    clear_ = 0;
+    generation_ = 0;
+    busy_ = 0;
+    next_tile_ = 0;
+    quit_ = false;
+  }
+
+  ~soft_rasterizer() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      quit_ = true;
+    }
+    start_.notify_all();
+    for (size_t i = 0; i != threads_.size(); ++i) {
+      threads_[i].join();
+    }
+  }
+
+  // threads = 0 uses every core. the calling thread works too.
+  void init(unsigned threads = 0) {
+    if (!threads) {
+      threads = std::thread::hardware_concurrency();
+    }
+    threads = threads < 1 ? 1 : threads > max_threads ? max_threads : threads;
+    for (unsigned i = 1; i < threads; ++i) {
+      threads_.push_back(std::thread(&soft_rasterizer::worker, this));
+    }
+  }
+
+  // start a frame of w x h pixels
+  void begin(int w, int h, const vec4 &clear) {
+    if (w != width_ || h != height_) {
+      width_ = w;
+      height_ = h;
+      pixels_.resize((size_t)w * h);
+      tiles_x_ = (w + tile_size - 1) >> tile_shift;
+      tiles_y_ = (h + tile_size - 1) >> tile_shift;
+      bins_.resize((size_t)tiles_x_ * tiles_y_);
+    }
+    for (size_t i = 0; i != bins_.size(); ++i) {
+      bins_[i].clear();
+    }
+    quads_.clear();
+    clear_ = pack(clear);
+  }
+
+  // the same quad as sprite_batch::quad, in normalized device coordinates
+  void quad(
+    const vec4 &center, const vec4 &x, const vec4 &y, const vec4 &color,
+    const soft_texture *texture = 0, float u0 = 0, float v0 = 0, float u1 = 1, float v1 = 1
+  ) {
+    // to pixels, with y going down the screen, snapped like the GPU does
+    float sx = width_ * 0.5f, sy = -height_ * 0.5f;
+    soft_quad q;
+    q.px = snap((center[0] - x[0] - y[0] + 1) * sx);
+    q.py = snap((center[1] - x[1] - y[1] - 1) * sy);
+    q.exx = snap((center[0] + x[0] - y[0] + 1) * sx) - q.px;
+    q.exy = snap((center[1] + x[1] - y[1] - 1) * sy) - q.py;
+    q.eyx = snap((center[0] - x[0] + y[0] + 1) * sx) - q.px;
+    q.eyy = snap((center[1] - x[1] + y[1] - 1) * sy) - q.py;
+    q.color = pack(color);
+    q.texture = texture;
+
+    // uv = uv0 + s * (u1 - u0, 0) + t * (0, v1 - v0), with s, t along the edges
+    float det = q.exx * q.eyy - q.exy * q.eyx;
+    if (det == 0) return;
+    float dsdx = q.eyy / det, dsdy = -q.eyx / det;
+    float dtdx = -q.exy / det, dtdy = q.exx / det;
+    q.dudx = (u1 - u0) * dsdx; q.dudy = (u1 - u0) * dsdy;
+    q.dvdx = (v1 - v0) * dtdx; q.dvdy = (v1 - v0) * dtdy;
+    q.u0 = u0 - q.dudx * q.px - q.dudy * q.py;
+    q.v0 = v0 - q.dvdx * q.px - q.dvdy * q.py;
+
+    // bounding box of the corners
+    float xs[4] = { q.px, q.px + q.exx, q.px + q.exx + q.eyx, q.px + q.eyx };
+    float ys[4] = { q.py, q.py + q.exy, q.py + q.exy + q.eyy, q.py + q.eyy };
+    float lx = xs[0], hx = xs[0], ly = ys[0], hy = ys[0];
+    for (int i = 1; i != 4; ++i) {
+      lx = xs[i] < lx ? xs[i] : lx; hx = xs[i] > hx ? xs[i] : hx;
+      ly = ys[i] < ly ? ys[i] : ly; hy = ys[i] > hy ? ys[i] : hy;
+    }
+    q.axis_aligned = q.exy == 0 && q.eyx == 0;
+    if (q.axis_aligned) {
+      // centers on the left and bottom edges are in, on the right and top out
+      q.x0 = (int)ceilf(lx - 0.5f); q.x1 = (int)ceilf(hx - 0.5f);
+      q.y0 = (int)floorf(ly - 0.5f) + 1; q.y1 = (int)floorf(hy - 0.5f) + 1;
+    } else {
+      // the spans decide
+      q.x0 = (int)floorf(lx); q.x1 = (int)ceilf(hx);
+      q.y0 = (int)floorf(ly); q.y1 = (int)ceilf(hy);
+    }
+    q.x0 = q.x0 < 0 ? 0 : q.x0; q.y0 = q.y0 < 0 ? 0 : q.y0;
+    q.x1 = q.x1 > width_ ? width_ : q.x1; q.y1 = q.y1 > height_ ? height_ : q.y1;
+    if (q.x0 >= q.x1 || q.y0 >= q.y1) return;
+
+    // bin it into every tile it touches
+    unsigned index = (unsigned)quads_.size();
+    quads_.push_back(q);
+    for (int ty = q.y0 >> tile_shift; ty <= (q.y1 - 1) >> tile_shift; ++ty) {
+      for (int tx = q.x0 >> tile_shift; tx <= (q.x1 - 1) >> tile_shift; ++tx) {
+        bins_[ty * tiles_x_ + tx].push_back(index);
+      }
+    }
+  }
+
+  // same as sprite_batch::box and sprite_batch::sprite
+  void box(const vec4 &center, const vec4 &half_extents, const vec4 &color, const vec4 &axis) {
+    quad(center, axis * half_extents[0], vec4(-axis[1], axis[0], 0, 0) * half_extents[1], color);
+  }
+
+  void sprite(const soft_texture &texture, const vec4 &center, const vec4 &half_extents, const vec4 &color) {
+    quad(center, vec4(half_extents[0], 0, 0, 0), vec4(0, half_extents[1], 0, 0), color, &texture);
+  }
+
+  // draw every tile. returns when the frame is complete.
+  void finish() {
+    next_tile_ = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      busy_ = (unsigned)threads_.size();
+      ++generation_;
+    }
+    start_.notify_all();
+    work();
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&] { return busy_ == 0; });
+  }
+
+  // RGBA8, top row first: ready to save or blit
+  const unsigned char *pixels() const { return (const unsigned char*)&pixels_[0]; }
+  int width() const { return width_; }
+  int height() const { return height_; }
+  unsigned num_threads() const { return (unsigned)threads_.size() + 1; }
+};
@@ -0,0 +1,182 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// sprite batcher
+//
+// Quads with a color per vertex are written straight into a gpu_ring, so
+// they need no copy before drawing. A static index buffer turns every four vertices into
+// two triangles, so each run of quads with the same shader and texture is a
+// single glDrawElements. Untextured boxes use a white texel so that they
+// batch with everything else: a 1x1 texture of their own by default, or the
+// white region of a texture_atlas so that sprites packed into the same page
+// never switch textures at all.
+//
+// With vertex array objects the batch keeps one of its own, holding the index
+// buffer and the enabled attributes, so a flush only points the three
+// attributes at the new run.
+//
+
+class sprite_batch {
+  // 16 bit indices address 65536 vertices
+  enum { max_quads = 16384 };
+
+  struct vertex {
+    float x, y;
+    float u, v;
+    unsigned char color[4];
+  };
+
+  // the run of quads being written, reserved in the ring
+  gpu_ring *ring_;
+  vertex *vertices_;
+  unsigned num_quads_;
+  unsigned max_run_;
+
+  GLuint vertex_array_;     // 0 without vertex array objects
+  GLuint index_buffer_;
+  atlas_region white_;
+
+  // the current batch
+  shader *shader_;
+  GLuint texture_;
+
+public:
+  // colors are sent as RGBA8
+  static unsigned char to_byte(float f) {
+    return (unsigned char)(f <= 0 ? 0 : f >= 1 ? 255 : f * 255 + 0.5f);
+  }
+
+  sprite_batch() {
+    ring_ = 0;
+    vertices_ = 0;
+    num_quads_ = 0;
+    max_run_ = 0;
+    vertex_array_ = 0;
+    shader_ = 0;
+    texture_ = 0;
+  }
+
+  void init(gpu_ring &ring) {
+    ring_ = &ring;
+    gl_state &gl = gl_state::get();
+    if (gl_has_vertex_arrays()) {
+      glGenVertexArrays(1, &vertex_array_);
+      gl.bind_vertex_array(vertex_array_);
+    }
+
+    // 0 1 2, 0 2 3 for every quad
+    GLushort *indices = (GLushort*)malloc(max_quads * 6 * sizeof(GLushort));
+    for (unsigned q = 0; q != max_quads; ++q) {
+      GLushort base = (GLushort)(q * 4);
+      GLushort *i = indices + q * 6;
+      i[0] = base; i[1] = base + 1; i[2] = base + 2;
+      i[3] = base; i[4] = base + 2; i[5] = base + 3;
+    }
+    glGenBuffers(1, &index_buffer_);
+    gl.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, max_quads * 6 * sizeof(GLushort), indices, GL_STATIC_DRAW);
+    free(indices);
+
+    unsigned char white[4] = { 255, 255, 255, 255 };
+    atlas_region own = { 0, 0, 0, 1, 1 };
+    white_ = own;
+    glGenTextures(1, &white_.texture);
+    gl.bind_texture(0, white_.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  }
+
+  // draw untextured boxes from this region instead of the 1x1 texture
+  void set_white(const atlas_region &white) {
+    // sample the middle of the region so filtering stays inside it
+    float u = (white.u0 + white.u1) * 0.5f, v = (white.v0 + white.v1) * 0.5f;
+    atlas_region centre = { white.texture, u, v, u, v };
+    white_ = centre;
+  }
+
+  // changing the shader or texture ends the current batch
+  void set_shader(shader &shader) {
+    if (&shader != shader_) {
+      flush();
+      shader_ = &shader;
+    }
+  }
+
+  void set_texture(GLuint texture) {
+    if (texture != texture_) {
+      flush();
+      texture_ = texture;
+    }
+  }
+
+  // a quad with corners center -/+ x -/+ y and texture coordinates uv0 to uv1
+  void quad(const vec4 &center, const vec4 &x, const vec4 &y, const vec4 &color, float u0, float v0, float u1, float v1) {
+    if (num_quads_ == max_run_) {
+      // start a new run in whatever space the ring has left
+      flush();
+      size_t quad_bytes = 4 * sizeof(vertex);
+      vertices_ = (vertex*)ring_->reserve(quad_bytes, 4);
+      size_t room = ring_->available() / quad_bytes;
+      max_run_ = room < max_quads ? (unsigned)room : (unsigned)max_quads;
+    }
+
+    unsigned char rgba[4] = { to_byte(color[0]), to_byte(color[1]), to_byte(color[2]), to_byte(color[3]) };
+    vertex *v = vertices_ + num_quads_ * 4;
+    v[0].x = center[0] - x[0] - y[0]; v[0].y = center[1] - x[1] - y[1]; v[0].u = u0; v[0].v = v0;
+    v[1].x = center[0] + x[0] - y[0]; v[1].y = center[1] + x[1] - y[1]; v[1].u = u1; v[1].v = v0;
+    v[2].x = center[0] + x[0] + y[0]; v[2].y = center[1] + x[1] + y[1]; v[2].u = u1; v[2].v = v1;
+    v[3].x = center[0] - x[0] + y[0]; v[3].y = center[1] - x[1] + y[1]; v[3].u = u0; v[3].v = v1;
+    for (int i = 0; i != 4; ++i) {
+      memcpy(v[i].color, rgba, 4);
+    }
+    num_quads_++;
+  }
+
+  // an untextured box, rotated so that its x axis is axis
+  void box(const vec4 &center, const vec4 &half_extents, const vec4 &color, const vec4 &axis) {
+    set_texture(white_.texture);
+    vec4 x = axis * half_extents[0];
+    vec4 y = vec4(-axis[1], axis[0], 0, 0) * half_extents[1];
+    quad(center, x, y, color, white_.u0, white_.v0, white_.u1, white_.v1);
+  }
+
+  // an axis aligned textured rectangle
+  void sprite(GLuint texture, const vec4 &center, const vec4 &half_extents, const vec4 &color) {
+    set_texture(texture);
+    quad(center, vec4(half_extents[0], 0, 0, 0), vec4(0, half_extents[1], 0, 0), color, 0, 0, 1, 1);
+  }
+
+  // an axis aligned rectangle from a texture atlas
+  void sprite(const atlas_region &region, const vec4 &center, const vec4 &half_extents, const vec4 &color) {
+    set_texture(region.texture);
+    quad(
+      center, vec4(half_extents[0], 0, 0, 0), vec4(0, half_extents[1], 0, 0), color,
+      region.u0, region.v0, region.u1, region.v1
+    );
+  }
+
+  // send the current batch to the GPU as one draw call.
+  // this also gives up the rest of the run so that others can use the ring.
+  void flush() {
+    unsigned num_quads = num_quads_;
+    num_quads_ = max_run_ = 0;
+    if (!num_quads) return;
+
+    gl_state &gl = gl_state::get();
+    shader_->use();
+    gl.bind_texture(0, texture_);
+
+    char *offset = (char*)ring_->commit(num_quads * 4 * sizeof(vertex));
+    if (vertex_array_) gl.bind_vertex_array(vertex_array_);
+    gl.bind_buffer(GL_ARRAY_BUFFER, ring_->buffer());
+    gl.enable_attribs(
+      gl.attrib_pointer(attrib_pos, 2, GL_FLOAT, GL_FALSE, sizeof(vertex), offset + offsetof(vertex, x)) |
+      gl.attrib_pointer(attrib_uv, 2, GL_FLOAT, GL_FALSE, sizeof(vertex), offset + offsetof(vertex, u)) |
+      gl.attrib_pointer(attrib_color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(vertex), offset + offsetof(vertex, color))
+    );
+
+    gl.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+    glDrawElements(GL_TRIANGLES, num_quads * 6, GL_UNSIGNED_SHORT, (void*)0);
+    render_stats::get().draw_call(num_quads);
+  }
+};
@@ -0,0 +1,236 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// game systems
+//
+// Each system walks the component columns of every archetype that has
+// the components it needs, so adding entities never changes the code.
+//
+
+// a ball touching a collider this tick
+struct contact {
+  entity_id ball;
+  entity_id other;
+  unsigned flags;
+};
+
+// contacts found by the collision system
+class contact_list {
+  enum { max_contacts = 256 };
+  contact contacts_[max_contacts];
+  unsigned size_;
+public:
+  contact_list() { size_ = 0; }
+  void clear() { size_ = 0; }
+  void push(const contact &c) { if (size_ != max_contacts) contacts_[size_++] = c; }
+  unsigned size() const { return size_; }
+  const contact &operator[](unsigned i) const { return contacts_[i]; }
+};
+
+// boxes pulled out of the world for drawing
+class render_list {
+  box *boxes_;
+  unsigned size_;
+  unsigned capacity_;
+public:
+  render_list() { boxes_ = 0; size_ = 0; capacity_ = 0; }
+  ~render_list() { free(boxes_); }
+
+  void clear() { size_ = 0; }
+
+  void push(const vec4 &center, const vec4 &half_extents, const vec4 &color, const vec4 &axis = vec4(1, 0, 0, 0)) {
+    if (size_ == capacity_) {
+      capacity_ = capacity_ ? capacity_ * 2 : 64;
+      boxes_ = (box*)realloc(boxes_, capacity_ * sizeof(box));
+    }
+    boxes_[size_++].init(center, half_extents, color, axis);
+  }
+
+  unsigned size() const { return size_; }
+  box &operator[](unsigned i) { return boxes_[i]; }
+};
+
+// movement: integrate the velocity of everything that moves
+inline void movement_system(world &w) {
+  w.each(component_bit(component_position) | component_bit(component_velocity), [](archetype &t) {
+    vec4 *pos = t.column<vec4>(component_position);
+    const vec4 *vel = t.column<vec4>(component_velocity);
+    for (unsigned i = 0, n = t.size(); i != n; ++i) {
+      pos[i] += vel[i];
+    }
+  });
+}
+
+// the x axis of a box rotated by quaternion q: the first row of its matrix
+inline vec4 rotation_axis(const vec4 &q) {
+  mat4 m = mat4(quat(q));
+  return m[0].xyz();
+}
+
+// rotation: turn everything that spins
+inline void rotation_system(world &w) {
+  w.each(component_bit(component_rotation) | component_bit(component_spin), [](archetype &t) {
+    vec4 *rot = t.column<vec4>(component_rotation);
+    const vec4 *spin = t.column<vec4>(component_spin);
+    for (unsigned i = 0, n = t.size(); i != n; ++i) {
+      // renormalise so that rounding errors do not build up
+      rot[i] = (quat(rot[i]) * quat(spin[i])).normalise();
+    }
+  });
+}
+
+// collision: bounce balls off the top and bottom of the court
+// and record every collider each ball overlaps.
+inline void collision_system(world &w, float court_size, contact_list &contacts) {
+  contacts.clear();
+
+  component_mask ball_mask =
+    component_bit(tag_ball) | component_bit(component_position) |
+    component_bit(component_extent) | component_bit(component_velocity)
+  ;
+  component_mask collider_mask =
+    component_bit(component_position) | component_bit(component_extent) | component_bit(component_collider)
+  ;
+
+  w.each(ball_mask, [&](archetype &balls) {
+    vec4 *ball_pos = balls.column<vec4>(component_position);
+    vec4 *ball_half = balls.column<vec4>(component_extent);
+    vec4 *ball_vel = balls.column<vec4>(component_velocity);
+
+    for (unsigned b = 0, nb = balls.size(); b != nb; ++b) {
+      // bounce
+      if (
+        (ball_vel[b][1] > 0 && ball_pos[b][1] > court_size) ||
+        (ball_vel[b][1] < 0 && ball_pos[b][1] < -court_size)
+      ) {
+        ball_vel[b] = ball_vel[b] * vec4(1, -1, 1, 1);
+      }
+
+      vec4 bp = ball_pos[b];
+      vec4 bh = ball_half[b];
+      w.each(collider_mask, [&](archetype &t) {
+        const vec4 *pos = t.column<vec4>(component_position);
+        const vec4 *half = t.column<vec4>(component_extent);
+        const unsigned *flags = t.column<unsigned>(component_collider);
+        for (unsigned i = 0, n = t.size(); i != n; ++i) {
+          float dx = fabsf(pos[i][0] - bp[0]);
+          float dy = fabsf(pos[i][1] - bp[1]);
+          if (dx < half[i][0] + bh[0] && dy < half[i][1] + bh[1]) {
+            contact c = { balls.entities()[b], t.entities()[i], flags[i] };
+            contacts.push(c);
+          }
+        }
+      });
+    }
+  });
+}
+
+// reflect a ball off a bat. note we don't just simply reverse the ball...
+//   this would lead to a feedback loop.
+inline bool bounce_off_bat(vec4 &ball_pos, vec4 &ball_vel, const vec4 &bat_pos) {
+  if ((bat_pos[0] - ball_pos[0]) * ball_vel[0] > 0) {
+    ball_vel = ball_vel * vec4(-1, 1, 1, 1);
+    return true;
+  }
+  return false;
+}
+
+// reflect a ball off a solid box along the axis of least penetration
+// and push it out so that it cannot stick inside a moving box.
+inline void bounce_off_box(vec4 &ball_pos, vec4 &ball_vel, const vec4 &ball_half, const vec4 &pos, const vec4 &half) {
+  vec4 diff = ball_pos - pos;
+  vec4 reach = ball_half + half;
+  float px = reach[0] - fabsf(diff[0]);
+  float py = reach[1] - fabsf(diff[1]);
+  int axis = px < py ? 0 : 1;
+  float side = diff[axis] < 0 ? -1.0f : 1.0f;
+
+  ball_pos[axis] = pos[axis] + side * reach[axis];
+  if (ball_vel[axis] * side < 0) {
+    ball_vel[axis] = -ball_vel[axis];
+  }
+}
+
+// reflect a ball off a surface with unit normal n after pushing it depth along n
+inline void bounce_off_normal(vec4 &ball_pos, vec4 &ball_vel, float nx, float ny, float depth) {
+  ball_pos[0] += nx * depth;
+  ball_pos[1] += ny * depth;
+  float along = ball_vel[0] * nx + ball_vel[1] * ny;
+  if (along < 0) {
+    ball_vel[0] -= 2 * along * nx;
+    ball_vel[1] -= 2 * along * ny;
+  }
+}
+
+// rotated obstacles: gather them into an obb_set, then test every ball
+// against all of them with the SIMD separating axis test and bounce.
+inline void obb_collision_system(world &w, obb_set &obbs) {
+  component_mask obb_mask =
+    component_bit(tag_obstacle) | component_bit(component_position) |
+    component_bit(component_extent) | component_bit(component_rotation)
+  ;
+  obbs.clear();
+  w.each(obb_mask, [&](archetype &t) {
+    const vec4 *pos = t.column<vec4>(component_position);
+    const vec4 *half = t.column<vec4>(component_extent);
+    const vec4 *rot = t.column<vec4>(component_rotation);
+    for (unsigned i = 0, n = t.size(); i != n; ++i) {
+      obbs.push(t.entities()[i], pos[i], half[i], rotation_axis(rot[i]));
+    }
+  });
+  obbs.finish();
+  if (!obbs.size()) return;
+
+  component_mask ball_mask =
+    component_bit(tag_ball) | component_bit(component_position) |
+    component_bit(component_extent) | component_bit(component_velocity)
+  ;
+  w.each(ball_mask, [&](archetype &balls) {
+    vec4 *ball_pos = balls.column<vec4>(component_position);
+    vec4 *ball_half = balls.column<vec4>(component_extent);
+    vec4 *ball_vel = balls.column<vec4>(component_velocity);
+    for (unsigned b = 0, nb = balls.size(); b != nb; ++b) {
+      obbs.overlaps(ball_pos[b], ball_half[b], [&](unsigned i, float nx, float ny, float depth) {
+        bounce_off_normal(ball_pos[b], ball_vel[b], nx, ny, depth);
+      });
+    }
+  });
+}
+
+// scoring: returns the player who scored, or -1
+inline int scoring_system(world &w) {
+  int scorer = -1;
+  w.each(component_bit(tag_ball) | component_bit(component_position), [&](archetype &balls) {
+    const vec4 *pos = balls.column<vec4>(component_position);
+    for (unsigned b = 0, nb = balls.size(); b != nb; ++b) {
+      if (pos[b][0] > 1) {
+        scorer = 0;
+      } else if (pos[b][0] < -1) {
+        scorer = 1;
+      }
+    }
+  });
+  return scorer;
+}
+
+// render extraction: copy everything visible into a flat list of boxes
+inline void render_extraction_system(world &w, render_list &list) {
+  list.clear();
+  component_mask mask =
+    component_bit(component_position) | component_bit(component_extent) | component_bit(component_color)
+  ;
+  w.each(mask, [&](archetype &t) {
+    const vec4 *pos = t.column<vec4>(component_position);
+    const vec4 *half = t.column<vec4>(component_extent);
+    const vec4 *color = t.column<vec4>(component_color);
+    if (t.has(component_rotation)) {
+      const vec4 *rot = t.column<vec4>(component_rotation);
+      for (unsigned i = 0, n = t.size(); i != n; ++i) {
+        list.push(pos[i], half[i], color[i], rotation_axis(rot[i]));
+      }
+    } else {
+      for (unsigned i = 0, n = t.size(); i != n; ++i) {
+        list.push(pos[i], half[i], color[i]);
+      }
+    }
+  });
+}
@@ -0,0 +1,146 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// bitmap text
+//
+// A 5x7 font for ASCII 32 to 126 is baked into one sheet, which goes into
+// the texture atlas the first time GL text is drawn. Each character is one
+// textured quad in the sprite batch, and the font shares its atlas page with
+// the background and the untextured boxes, so a line of text costs no extra
+// draw calls. The sprite shader discards texels with no alpha, so glyphs
+// need no blending. The software rasterizer draws from the sheet directly.
+//
+
+class bitmap_font {
+  enum {
+    first_char = 32,
+    num_chars = 95,
+    glyph_w = 5,
+    glyph_h = 7,
+    cell_w = glyph_w + 1,   // a blank column and row between glyphs
+    cell_h = glyph_h + 1,
+    columns = 16,
+    rows = (num_chars + columns - 1) / columns,
+  };
+
+  std::vector<unsigned char> pixels_;
+  soft_texture soft_;
+  atlas_region sheet_;
+
+  // one byte per column, top row in bit 0
+  static const unsigned char *glyph(int c) {
+    static const unsigned char glyphs[num_chars][glyph_w] = {
+      { 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5f, 0x00, 0x00 }, { 0x00, 0x07, 0x00, 0x07, 0x00 }, { 0x14, 0x7f, 0x14, 0x7f, 0x14 }, //  !"#
+      { 0x24, 0x2a, 0x7f, 0x2a, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 }, { 0x36, 0x49, 0x55, 0x22, 0x50 }, { 0x00, 0x05, 0x03, 0x00, 0x00 }, // $%&'
+      { 0x00, 0x1c, 0x22, 0x41, 0x00 }, { 0x00, 0x41, 0x22, 0x1c, 0x00 }, { 0x08, 0x2a, 0x1c, 0x2a, 0x08 }, { 0x08, 0x08, 0x3e, 0x08, 0x08 }, // ()*+
+      { 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 }, { 0x00, 0x60, 0x60, 0x00, 0x00 }, { 0x20, 0x10, 0x08, 0x04, 0x02 }, // ,-./
+      { 0x3e, 0x51, 0x49, 0x45, 0x3e }, { 0x00, 0x42, 0x7f, 0x40, 0x00 }, { 0x42, 0x61, 0x51, 0x49, 0x46 }, { 0x21, 0x41, 0x45, 0x4b, 0x31 }, // 0123
+      { 0x18, 0x14, 0x12, 0x7f, 0x10 }, { 0x27, 0x45, 0x45, 0x45, 0x39 }, { 0x3c, 0x4a, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 }, // 4567
+      { 0x36, 0x49, 0x49, 0x49, 0x36 }, { 0x06, 0x49, 0x49, 0x29, 0x1e }, { 0x00, 0x36, 0x36, 0x00, 0x00 }, { 0x00, 0x56, 0x36, 0x00, 0x00 }, // 89:;
+      { 0x08, 0x14, 0x22, 0x41, 0x00 }, { 0x14, 0x14, 0x14, 0x14, 0x14 }, { 0x00, 0x41, 0x22, 0x14, 0x08 }, { 0x02, 0x01, 0x51, 0x09, 0x06 }, // <=>?
+      { 0x32, 0x49, 0x79, 0x41, 0x3e }, { 0x7e, 0x11, 0x11, 0x11, 0x7e }, { 0x7f, 0x49, 0x49, 0x49, 0x36 }, { 0x3e, 0x41, 0x41, 0x41, 0x22 }, // @ABC
+      { 0x7f, 0x41, 0x41, 0x22, 0x1c }, { 0x7f, 0x49, 0x49, 0x49, 0x41 }, { 0x7f, 0x09, 0x09, 0x01, 0x01 }, { 0x3e, 0x41, 0x41, 0x51, 0x32 }, // DEFG
+      { 0x7f, 0x08, 0x08, 0x08, 0x7f }, { 0x00, 0x41, 0x7f, 0x41, 0x00 }, { 0x20, 0x40, 0x41, 0x3f, 0x01 }, { 0x7f, 0x08, 0x14, 0x22, 0x41 }, // HIJK
+      { 0x7f, 0x40, 0x40, 0x40, 0x40 }, { 0x7f, 0x02, 0x04, 0x02, 0x7f }, { 0x7f, 0x04, 0x08, 0x10, 0x7f }, { 0x3e, 0x41, 0x41, 0x41, 0x3e }, // LMNO
+      { 0x7f, 0x09, 0x09, 0x09, 0x06 }, { 0x3e, 0x41, 0x51, 0x21, 0x5e }, { 0x7f, 0x09, 0x19, 0x29, 0x46 }, { 0x46, 0x49, 0x49, 0x49, 0x31 }, // PQRS
+      { 0x01, 0x01, 0x7f, 0x01, 0x01 }, { 0x3f, 0x40, 0x40, 0x40, 0x3f }, { 0x1f, 0x20, 0x40, 0x20, 0x1f }, { 0x7f, 0x20, 0x18, 0x20, 0x7f }, // TUVW
+      { 0x63, 0x14, 0x08, 0x14, 0x63 }, { 0x03, 0x04, 0x78, 0x04, 0x03 }, { 0x61, 0x51, 0x49, 0x45, 0x43 }, { 0x00, 0x7f, 0x41, 0x41, 0x00 }, // XYZ[
+      { 0x02, 0x04, 0x08, 0x10, 0x20 }, { 0x00, 0x41, 0x41, 0x7f, 0x00 }, { 0x04, 0x02, 0x01, 0x02, 0x04 }, { 0x40, 0x40, 0x40, 0x40, 0x40 }, // \]^_
+      { 0x00, 0x01, 0x02, 0x04, 0x00 }, { 0x20, 0x54, 0x54, 0x54, 0x78 }, { 0x7f, 0x48, 0x44, 0x44, 0x38 }, { 0x38, 0x44, 0x44, 0x44, 0x20 }, // `abc
+      { 0x38, 0x44, 0x44, 0x48, 0x7f }, { 0x38, 0x54, 0x54, 0x54, 0x18 }, { 0x08, 0x7e, 0x09, 0x01, 0x02 }, { 0x08, 0x14, 0x54, 0x54, 0x3c }, // defg
+      { 0x7f, 0x08, 0x04, 0x04, 0x78 }, { 0x00, 0x44, 0x7d, 0x40, 0x00 }, { 0x20, 0x40, 0x44, 0x3d, 0x00 }, { 0x00, 0x7f, 0x10, 0x28, 0x44 }, // hijk
+      { 0x00, 0x41, 0x7f, 0x40, 0x00 }, { 0x7c, 0x04, 0x18, 0x04, 0x78 }, { 0x7c, 0x08, 0x04, 0x04, 0x78 }, { 0x38, 0x44, 0x44, 0x44, 0x38 }, // lmno
+      { 0x7c, 0x14, 0x14, 0x14, 0x08 }, { 0x08, 0x14, 0x14, 0x18, 0x7c }, { 0x7c, 0x08, 0x04, 0x04, 0x08 }, { 0x48, 0x54, 0x54, 0x54, 0x20 }, // pqrs
+      { 0x04, 0x3f, 0x44, 0x40, 0x20 }, { 0x3c, 0x40, 0x40, 0x20, 0x7c }, { 0x1c, 0x20, 0x40, 0x20, 0x1c }, { 0x3c, 0x40, 0x30, 0x40, 0x3c }, // tuvw
+      { 0x44, 0x28, 0x10, 0x28, 0x44 }, { 0x0c, 0x50, 0x50, 0x50, 0x3c }, { 0x44, 0x64, 0x54, 0x4c, 0x44 }, { 0x00, 0x08, 0x36, 0x41, 0x00 }, // xyz{
+      { 0x00, 0x00, 0x7f, 0x00, 0x00 }, { 0x00, 0x41, 0x36, 0x08, 0x00 }, { 0x02, 0x01, 0x02, 0x04, 0x02 },                                   // |}~
+    };
+    return glyphs[c < first_char || c >= first_char + num_chars ? '?' - first_char : c - first_char];
+  }
+
+  bitmap_font() {
+    int w = columns * cell_w, h = rows * cell_h;
+    std::vector<unsigned char> &pixels = pixels_;
+    pixels.assign(w * h * 4, 0);
+    for (int c = 0; c != num_chars; ++c) {
+      const unsigned char *columns_of = glyph(c + first_char);
+      int x0 = (c % columns) * cell_w, y0 = (c / columns) * cell_h;
+      for (int x = 0; x != glyph_w; ++x) {
+        for (int y = 0; y != glyph_h; ++y) {
+          if ((columns_of[x] >> y) & 1) {
+            // rows go up the texture, so the glyph's top row is its last
+            unsigned char *p = &pixels[((y0 + glyph_h - 1 - y) * w + x0 + x) * 4];
+            p[0] = p[1] = p[2] = p[3] = 255;
+          }
+        }
+      }
+    }
+    soft_.pixels = &pixels[0];
+    soft_.width = w;
+    soft_.height = h;
+    memset(&sheet_, 0, sizeof(sheet_));
+  }
+public:
+  // the sheet in the atlas, for GL
+  const atlas_region &sheet() {
+    if (!sheet_.texture) {
+      sheet_ = texture_atlas::get().add(&pixels_[0], soft_.width, soft_.height);
+    }
+    return sheet_;
+  }
+
+  // ...and for the software rasterizer
+  const soft_texture &soft_sheet() const { return soft_; }
+
+  // the texture coordinates of one character in a sheet that spans u0 to u1
+  static void uv(int c, const atlas_region &sheet, float &u0, float &v0, float &u1, float &v1) {
+    c = c < first_char || c >= first_char + num_chars ? '?' : c;
+    int cell = c - first_char;
+    float du = (sheet.u1 - sheet.u0) / (columns * cell_w), dv = (sheet.v1 - sheet.v0) / (rows * cell_h);
+    u0 = sheet.u0 + (cell % columns) * cell_w * du;
+    v0 = sheet.v0 + (cell / columns) * cell_h * dv;
+    u1 = u0 + (int)glyph_w * du;
+    v1 = v0 + (int)glyph_h * dv;
+  }
+
+  // a character's width and advance as a fraction of its height
+  static float aspect() { return (float)glyph_w / (int)glyph_h; }
+  static float advance() { return (float)cell_w / (int)glyph_h; }
+
+  static bitmap_font &get() {
+    static bitmap_font the_font;
+    return the_font;
+  }
+};
+
+// one character, through the sprite batch...
+inline void text_quad(sprite_batch &batch, int c, const vec4 &center, const vec4 &half_x, const vec4 &half_y, const vec4 &color) {
+  const atlas_region &sheet = bitmap_font::get().sheet();
+  float u0, v0, u1, v1;
+  bitmap_font::uv(c, sheet, u0, v0, u1, v1);
+  batch.set_texture(sheet.texture);
+  batch.quad(center, half_x, half_y, color, u0, v0, u1, v1);
+}
+
+// ...or the software rasterizer
+inline void text_quad(soft_rasterizer &raster, int c, const vec4 &center, const vec4 &half_x, const vec4 &half_y, const vec4 &color) {
+  atlas_region whole = { 0, 0, 0, 1, 1 };
+  float u0, v0, u1, v1;
+  bitmap_font::uv(c, whole, u0, v0, u1, v1);
+  raster.quad(center, half_x, half_y, color, &bitmap_font::get().soft_sheet(), u0, v0, u1, v1);
+}
+
+// draw a line of text with its top left corner at (x, y), in characters height high
+template <class Sink> void draw_text(Sink &sink, const char *text, float x, float y, float height, const vec4 &color) {
+  vec4 half_x(height * bitmap_font::aspect() * 0.5f, 0, 0, 0), half_y(0, height * 0.5f, 0, 0);
+  for (; *text; ++text, x += height * bitmap_font::advance()) {
+    if (*text != ' ') {
+      text_quad(sink, (unsigned char)*text, vec4(x + half_x[0], y - half_y[1], 0, 1), half_x, half_y, color);
+    }
+  }
+}
+
+// the width of a line of text
+inline float text_width(const char *text, float height) {
+  size_t n = strlen(text);
+  return n ? (n - 1) * height * bitmap_font::advance() + height * bitmap_font::aspect() : 0;
+}
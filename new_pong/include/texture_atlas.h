@@ -0,0 +1,198 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// texture atlas
+//
+// Packs sprites from any number of TGA files into a few big textures at run
+// time, using texture_manager to read the sub-rectangles. Each page is
+// packed with a skyline: the tops of the sprites placed so far form a list
+// of horizontal segments, and a new sprite goes wherever its top edge ends
+// up lowest. Sprites are padded with a copy of their edge pixels so that
+// filtering never picks up a neighbour.
+//
+// Page 0 starts with a small white square, so untextured boxes can be
+// drawn with the same texture as everything else.
+//
+
+// where a sprite ended up
+struct atlas_region {
+  GLuint texture;
+  float u0, v0, u1, v1;
+};
+
+class texture_atlas {
+  enum {
+    page_size = 1024,
+    max_pages = 8,
+    padding = 1,
+    white_size = 4,
+  };
+
+  struct segment {
+    int x, y, w;
+  };
+
+  struct page {
+    GLuint texture;
+    std::vector<segment> skyline;
+  };
+
+  page pages_[max_pages];
+  unsigned num_pages_;
+  atlas_region white_;
+
+  // the lowest y a w wide sprite can sit at starting at segment i, or -1
+  int fit(const page &p, size_t i, int w, int h) const {
+    int x = p.skyline[i].x;
+    if (x + w > page_size) return -1;
+    int y = 0;
+    for (int left = w; left > 0; ++i) {
+      y = p.skyline[i].y > y ? p.skyline[i].y : y;
+      if (y + h > page_size) return -1;
+      left -= p.skyline[i].w;
+    }
+    return y;
+  }
+
+  // raise the skyline over [x, x + w) to y
+  static void place(page &p, size_t i, int x, int y, int w) {
+    segment s = { x, y, w };
+    p.skyline.insert(p.skyline.begin() + i, s);
+
+    // trim or remove the segments the new one now covers
+    for (size_t j = i + 1; j < p.skyline.size(); ) {
+      segment &next = p.skyline[j];
+      int shrink = x + w - next.x;
+      if (shrink <= 0) break;
+      if (shrink < next.w) {
+        next.x += shrink;
+        next.w -= shrink;
+        break;
+      }
+      p.skyline.erase(p.skyline.begin() + j);
+    }
+
+    // merge neighbours of the same height
+    for (size_t j = 0; j + 1 < p.skyline.size(); ) {
+      if (p.skyline[j].y == p.skyline[j + 1].y) {
+        p.skyline[j].w += p.skyline[j + 1].w;
+        p.skyline.erase(p.skyline.begin() + j + 1);
+      } else {
+        ++j;
+      }
+    }
+  }
+
+  // find room for a w x h rectangle: lowest top edge first, then leftmost
+  bool allocate(page &p, int w, int h, int &x, int &y) {
+    int best_y = -1;
+    size_t best_i = 0;
+    for (size_t i = 0; i != p.skyline.size(); ++i) {
+      int top = fit(p, i, w, h);
+      if (top >= 0 && (best_y < 0 || top < best_y)) {
+        best_y = top;
+        best_i = i;
+      }
+    }
+    if (best_y < 0) return false;
+    x = p.skyline[best_i].x;
+    y = best_y;
+    place(p, best_i, x, y + h, w);
+    return true;
+  }
+
+  page *new_page() {
+    if (num_pages_ == max_pages) return 0;
+    page &p = pages_[num_pages_++];
+    segment all = { 0, 0, page_size };
+    p.skyline.assign(1, all);
+    glGenTextures(1, &p.texture);
+    gl_state::get().bind_texture(0, p.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, page_size, page_size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    return &p;
+  }
+
+  // copy w x h RGBA pixels in with their edges repeated into the padding
+  atlas_region pack(const unsigned char *pixels, int w, int h) {
+    int pw = w + padding * 2, ph = h + padding * 2;
+    int x = 0, y = 0;
+    page *p = 0;
+    for (unsigned i = 0; i != num_pages_ && !p; ++i) {
+      if (allocate(pages_[i], pw, ph, x, y)) p = &pages_[i];
+    }
+    if (!p) {
+      p = new_page();
+      if (!p || !allocate(*p, pw, ph, x, y)) {
+        atlas_region none = { 0, 0, 0, 1, 1 };
+        return none;
+      }
+    }
+
+    std::vector<unsigned char> padded(pw * ph * 4);
+    for (int py = 0; py != ph; ++py) {
+      int sy = py - padding;
+      sy = sy < 0 ? 0 : sy >= h ? h - 1 : sy;
+      for (int px = 0; px != pw; ++px) {
+        int sx = px - padding;
+        sx = sx < 0 ? 0 : sx >= w ? w - 1 : sx;
+        memcpy(&padded[(py * pw + px) * 4], pixels + (sy * w + sx) * 4, 4);
+      }
+    }
+    gl_state::get().bind_texture(0, p->texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, pw, ph, GL_RGBA, GL_UNSIGNED_BYTE, &padded[0]);
+
+    float scale = 1.0f / (float)page_size;
+    atlas_region r = {
+      p->texture,
+      (x + padding) * scale, (y + padding) * scale,
+      (x + padding + w) * scale, (y + padding + h) * scale
+    };
+    return r;
+  }
+
+  texture_atlas() {
+    num_pages_ = 0;
+    memset(&white_, 0, sizeof(white_));
+  }
+public:
+  // pack a sub-rectangle of a TGA file. Sprites bigger than a page get a
+  // texture of their own from texture_manager.
+  atlas_region add(const char *filename, int x, int y, int w, int h) {
+    if (w + padding * 2 > page_size || h + padding * 2 > page_size) {
+      atlas_region own = { texture_manager::new_texture(filename, x, y, w, h), 0, 0, 1, 1 };
+      return own;
+    }
+    unsigned char *pixels = texture_manager::new_pixels(filename, x, y, w, h);
+    if (!pixels) {
+      atlas_region none = { 0, 0, 0, 1, 1 };
+      return none;
+    }
+    atlas_region r = pack(pixels, w, h);
+    free(pixels);
+    return r;
+  }
+
+  // pack w x h RGBA pixels made at run time
+  atlas_region add(const unsigned char *pixels, int w, int h) {
+    return pack(pixels, w, h);
+  }
+
+  // a white region for untextured sprites, on the first page
+  const atlas_region &white() {
+    if (!white_.texture) {
+      unsigned char pixels[white_size * white_size * 4];
+      memset(pixels, 255, sizeof(pixels));
+      white_ = pack(pixels, white_size, white_size);
+    }
+    return white_;
+  }
+
+  unsigned num_pages() const { return num_pages_; }
+
+  static texture_atlas &get() {
+    static texture_atlas the_atlas;
+    return the_atlas;
+  }
+};
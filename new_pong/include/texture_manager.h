@@ -26,7 +26,7 @@ class texture_manager {
   };
 
   // read a pair of bytes as a little-endian value
-  int le2( uint8_t val[2] )
+  static int le2( uint8_t val[2] )
   {
     return val[0] + val[1] * 0x100;
   }
@@ -39,8 +39,9 @@ class texture_manager {
     cur_texture = 0;
   }
   
-  void init(GLuint texture, const char *tga_file, int xoff, int yoff, int w, int h) {
-    // convert the data
+  // convert a sub-rectangle of a TGA file to RGB or RGBA (out_bytes 3 or 4).
+  // returns malloced pixels, or 0 if the rectangle is not in the image.
+  static uint8_t *decode(const char *tga_file, int xoff, int yoff, int w, int h, int &out_bytes) {
     TgaHeader *header = (TgaHeader*)tga_file;
     const uint8_t *data = (uint8_t *)tga_file + sizeof(TgaHeader);
     
@@ -55,7 +56,11 @@ class texture_manager {
     assert(header->bits == 32 || header->bits == 24);
     
     int bytes = header->bits / 8;
-    uint8_t *tmp = (uint8_t *)malloc(w*h*bytes);
+    if (!out_bytes) out_bytes = bytes;
+    if (xoff < 0 || yoff < 0 || xoff + w > width || yoff + h > height) {
+      return 0;
+    }
+    uint8_t *tmp = (uint8_t *)malloc(w*h*out_bytes);
     uint8_t *dest = tmp;
 
     // swap red and blue!
@@ -84,19 +89,27 @@ class texture_manager {
           dest[0] = red;
           dest[1] = green;
           dest[2] = blue;
-          dest += 3;
+          if (out_bytes == 4) dest[3] = 255;
+          dest += out_bytes;
         }
       }
     }
+    return tmp;
+  }
+
+  void init(GLuint texture, const char *tga_file, int xoff, int yoff, int w, int h) {
+    // convert the data
+    int bytes = 0;
+    uint8_t *tmp = decode(tga_file, xoff, yoff, w, h, bytes);
+    if (!tmp) return;
 
     GLenum fmt = bytes == 4 ? GL_RGBA : GL_RGB;
-    glBindTexture(GL_TEXTURE_2D, texture);
+    gl_state::get().bind_texture(0, texture);
     glTexImage2D(GL_TEXTURE_2D, 0, fmt, w, h, 0, fmt, GL_UNSIGNED_BYTE, (void*)tmp);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     //glGenerateMipmap(GL_TEXTURE_2D);
     free(tmp);
-    glBindTexture(GL_TEXTURE_2D, 0);
   }
   
   GLuint get_texture(const char *filename, int x, int y, int w, int h) {
@@ -117,5 +130,13 @@ public:
   static GLuint new_texture(const char *filename, int x, int y, int w, int h) {
     return get().get_texture(filename, x, y, w, h);
   }
+
+  // the RGBA pixels of a sub-rectangle, for packing into an atlas.
+  // free() the result. returns 0 if the file or rectangle is missing.
+  static unsigned char *new_pixels(const char *filename, int x, int y, int w, int h) {
+    const char *data = (const char*)file_manager::bytes(filename);
+    int bytes = 4;
+    return data ? decode(data, x, y, w, h, bytes) : 0;
+  }
 };
 
@@ -0,0 +1,45 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// lock-free triple buffer
+//
+// One thread writes, one thread reads, and neither ever waits for the other.
+// Of the three slots the writer owns one (the back), the reader owns one
+// (the front) and the third sits in the middle holding the newest finished
+// value. publish() swaps the back into the middle, acquire() swaps the
+// middle into the front if it has been published since the last acquire.
+// The reader always sees the latest complete value and may skip some; the
+// writer never stalls on a slow reader.
+//
+
+template <class T> class triple_buffer {
+  // the middle index, and a bit set when it holds something the reader has not seen
+  enum { index_mask = 3, fresh = 4 };
+
+  T slots_[3];
+  std::atomic<unsigned> middle_;
+  unsigned back_;
+  unsigned front_;
+public:
+  triple_buffer() : slots_(), middle_(1) {
+    back_ = 0;
+    front_ = 2;
+  }
+
+  // writer: fill this in, then publish it. it holds stale data from an
+  // older value, so write every field.
+  T &back() { return slots_[back_]; }
+
+  void publish() {
+    back_ = middle_.exchange(back_ | fresh, std::memory_order_acq_rel) & index_mask;
+  }
+
+  // reader: take the newest published value. false if there is nothing new,
+  // in which case the front still holds the previous one.
+  bool acquire() {
+    if (!(middle_.load(std::memory_order_relaxed) & fresh)) return false;
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & index_mask;
+    return true;
+  }
+
+  T &front() { return slots_[front_]; }
+};
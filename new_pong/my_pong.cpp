@@ -13,15 +13,63 @@
   // This is the "GL utilities" framework for drawing with OpenGL
   #define FREEGLUT_STATIC
   #define FREEGLUT_LIB_PRAGMAS 0
-  #include "GL/glut.h"
-#else // (osx?)
+  #include "GL/freeglut.h"
+#elif defined(__APPLE__)
   #include "GLUT/glut.h"
+#else
+  // Linux: the system headers declare every entry point and libGL exports them
+  #define GL_GLEXT_PROTOTYPES
+  #include <GL/gl.h>
+  #include <GL/glext.h>
+  #include <GL/glx.h>
+  #include "GL/freeglut.h"
+#endif
+
+// offscreen contexts for headless runs
+#ifdef PONG_HEADLESS
+  #include <EGL/egl.h>
+  #include <EGL/eglext.h>
+#endif
+
+// memory mapped files
+#ifdef WIN32
+  #define NOMINMAX
+  #include <windows.h>
+  #pragma comment(lib, "winmm.lib")
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
 #endif
 
 // standard C headers
 #include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
 #include <math.h>
 #include <assert.h>
+#ifndef _MSC_VER
+  #define sprintf_s snprintf
+#endif
+
+// standard C++ headers
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <coroutine>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <new>
+
+// SIMD intrinsics
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
 
 // math support
 #include "include/vector.h"
@@ -29,557 +77,222 @@
 
 
 // shader wrapper & other graphics resources
+#include "include/render_stats.h"
+#include "include/alloc_stats.h"
+#include "include/gl_caps.h"
+#include "include/frame_pacer.h"
+#include "include/triple_buffer.h"
+#include "include/gl_state.h"
+#include "include/gpu_ring.h"
+#include "include/gpu_timers.h"
+#include "include/shader_cache.h"
 #include "include/shader.h"
-#include "include/shadertex.h"
-#include <file_manager.h>
+#include <file_manager.h>
 #include <texture_manager.h>
-GLuint background;
+#include "include/texture_atlas.h"
+#include "include/offscreen_target.h"
+#include "include/dynamic_resolution.h"
+#include "include/png_file.h"
+#include "include/frame_capture.h"
+#include "include/render_graph.h"
+#include "include/sprite_batch.h"
+#include "include/instanced_boxes.h"
+#include "include/soft_raster.h"
+#include "include/text.h"
+#include "include/particles.h"
+#include "include/command_buffer.h"
 
 // random number generation
 #include <ctime>
 #include <cstdlib>
 
-
-
-// Arrow Key Setup
-bool* key_special_states = new bool[246];
-bool* key_states = new bool[256];
-  
-void keySpecial (int key, int x, int y) {  
-	key_special_states[key] = true;
+// game objects and the systems that update them
+#include "include/box.h"
+#include "include/ecs.h"
+#include "include/obb.h"
+#include "include/systems.h"
+#include "include/script.h"
+#include "include/level.h"
+#include "include/brick_mesh.h"
+
+// the game core and the rule sets it can be built with
+#include "include/rules.h"
+#include "include/pong_game.h"
+
+// running without a window
+#include "include/headless.h"
+
+
+// the global allocation functions, replaced so that alloc_stats counts
+// every C++ heap allocation. they can only be defined in one file.
+static void *counted_new(size_t size, size_t align) {
+  alloc_stats::get().allocation();
+  if (!size) size = 1;
+  if (!align) return malloc(size);
+  #ifdef WIN32
+    return _aligned_malloc(size, align);
+  #else
+    void *p;
+    return posix_memalign(&p, align < sizeof(void*) ? sizeof(void*) : align, size) ? 0 : p;
+  #endif
 }
-void keySpecialUp (int key, int x, int y) {   
-	key_special_states[key] = false;
+
+static void *or_throw(void *p) {
+  if (!p) throw std::bad_alloc();
+  return p;
 }
 
-//Collision Test Setup
-bool collision_1_test;
-bool brick_dead[12] = {false};
-int brick_num = 12;
-vec4 brick_kill(0, 2.0f, 0, 0);
-bool brick_onscreen[12] = {true};
-
-// box class - holds shape and color of a box on the screen.
-class box {
-  vec4 center_;
-  vec4 half_extents_;
-  vec4 color_;
- 
-public:
-  // we don't have a constructor, but we do have an 'init' function
-  void init(float cx, float cy, float hx, float hy) {
-    // note that it is a convention for positions and colors
-    // to have "1" in the w, distances to have "0" in the w.
-    center_ = vec4(cx, cy, 0, 1);
-    half_extents_ = vec4(hx, hy, 0, 0);
-    color_ = vec4(1, 1, 1, 1);
-  }
+static void aligned_delete(void *p) {
+  #ifdef WIN32
+    _aligned_free(p);
+  #else
+    free(p);
+  #endif
+}
 
-  // draw the box using a triangle fan.
-  void draw(shader &shader) {
-    // set the uniforms
-    shader.render(color_);
-
-    // set the attributes    
-    float vertices[4*2] = {
-      center_[0] - half_extents_[0], center_[1] - half_extents_[1],
-      center_[0] + half_extents_[0], center_[1] - half_extents_[1],
-      center_[0] + half_extents_[0], center_[1] + half_extents_[1],
-      center_[0] - half_extents_[0], center_[1] + half_extents_[1],
-    };
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2*sizeof(float), (void*)vertices );
-    glEnableVertexAttribArray(0);
-
-    // kick the draw
-    glDrawArrays(GL_TRIANGLE_FAN, 0, 4); //vertices of every shape
-  }
-  
-  // move the box
-  void move(const vec4 &dir) {
-    center_ += dir;
-  }
+void *operator new(size_t size) { return or_throw(counted_new(size, 0)); }
+void *operator new[](size_t size) { return or_throw(counted_new(size, 0)); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return counted_new(size, 0); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return counted_new(size, 0); }
+void *operator new(size_t size, std::align_val_t align) { return or_throw(counted_new(size, (size_t)align)); }
+void *operator new[](size_t size, std::align_val_t align) { return or_throw(counted_new(size, (size_t)align)); }
+void *operator new(size_t size, std::align_val_t align, const std::nothrow_t &) noexcept { return counted_new(size, (size_t)align); }
+void *operator new[](size_t size, std::align_val_t align, const std::nothrow_t &) noexcept { return counted_new(size, (size_t)align); }
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { aligned_delete(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { aligned_delete(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { aligned_delete(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { aligned_delete(p); }
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept { aligned_delete(p); }
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept { aligned_delete(p); }
+
+
+// boilerplate to run the sample.
+//   my_pong                       bricks, moving obstacle and an AI opponent
+//   my_pong --level file.lvl      ...playing a level file
+//   my_pong --make-level file.lvl n [m]  write a level with a wall of n bricks
+//                                        and m spinning obstacles, then exit
+//   my_pong --classic             classic two player pong
+//   my_pong --headless n [--png file.png] [--golden file.png] [--tolerance t] [--dump-every k]
+//                                 draw n frames offscreen and time them (see headless.h)
+//   my_pong --pacing mode         vsync, adaptive, fixed[:hz] or uncapped (see frame_pacer.h)
+//                                 vsync and adaptive need Windows or Linux/X11
+//   my_pong --frame-times file.csv  write the frame time histogram on exit
+//   my_pong --gpu-times           time each render pass on the GPU and log it (see gpu_timers.h)
+//   my_pong --hud                 show frame rate, sim time, draw calls and allocations ('h' toggles)
+//   my_pong --particle-bench n    time one 240 Hz particle step for n particles (see particles.h)
+//   my_pong --dynamic-res ms      scale the resolution to keep GPU frame time under ms (see dynamic_resolution.h)
+//   my_pong --core                draw in a GL 3.3 core profile context (see shader.h)
+//   my_pong --capture file [--capture-fps n]  record to file.y4m or a PNG sequence like shot_%05u.png
+//                                 without stalling the GPU (see frame_capture.h)
+
+// print the frame times when the game exits, and save them if asked to
+static const char *frame_times_file = 0;
+
+// in-flight frames are read back while the context still exists
+static void finish_capture() {
+  frame_capture::get().finish();
+}
 
-  // the 'pos' property
-  vec4 pos() const { return center_; }
-  void set_pos(vec4 v) { center_ = v; }
-
-  // the 'sides' property
-  float r_side() const {return center_[0] + half_extents_[0];}
-  float l_side() const {return center_[0] - half_extents_[0];}
-  float t_side() const {return center_[1] + half_extents_[1];}
-  float b_side() const {return center_[1] - half_extents_[1];}
-
-  
-  // return true if two boxes intersect
-  bool intersects(const box &rhs) {
-    vec4 diff = (rhs.pos() - pos()).abs();
-    vec4 min_distance = rhs.half_extents_ + half_extents_;
-    return diff[0] < min_distance[0] && diff[1] < min_distance[1];
+static void report_frame_times() {
+  frame_histogram &times = frame_pacer::get().histogram();
+  times.print();
+  if (frame_times_file && !times.write(frame_times_file)) {
+    printf("can't write %s\n", frame_times_file);
   }
+}
 
-};
-
-			// THE GAME
-class NewPongGame
+int main(int argc, char **argv)
 {
-  // game state: always uses enums for int constants
-  enum state_t {
-    state_serving,
-    state_playing,
-    state_end,
-  };
-  
-  state_t state;
-  int server;
-
-  box bats[2];
-  box ball;
-  box obstacle;
-  box brick[12];
-  vec4 ball_velocity;
-  vec4 bat_ai;
-  vec4 move_obstacle;
-  int scores[2];
-  bool obstacle_switch;
-
-  // rendering  
-  shader colour_shader_;
-  GLint viewport_width_;
-  GLint viewport_height_;
-  shadertex texture_shader_;
-  
-  // input
-  char keys[256];
-  
-  // constants: always use functions for floats!
-  
-  float court_size() { return 0.98f; }              
-  float ball_speed() { return 0.01f; }
-
-
-
-  void draw_world(shader &shader)
-  {
-    ball.draw(shader);
- 
-    for (int player = 0; player != 2; ++player)
-	{
-      // draw the bat
-      bats[player].draw(shader);
-      obstacle.draw(shader);
-	
-	  for (int i = 0; i <= brick_num; ++i) {
-		  brick[i].draw(shader);
-		  }
-
-      box blob;								
-      float blob_size = 0.02f;
-      float blob_spacing = player == 0 ? -0.05f: 0.05f;
-      float blob_offset = player == 0 ? -0.1f : 0.1f;
-      
-      // draw the scores as blobs
-      for (int i = 0; i != scores[player]; ++i )
-	  {
-        blob.init(blob_offset + blob_spacing / 2 * i, 0.98f, blob_size / 2, blob_size);
-        blob.draw(shader);
+  bool classic = false;
+  headless_options headless_run;
+  pacing_mode pacing = pacing_fixed;
+  double pacing_hz = 0;
+  const char *capture_file = 0;
+  int capture_fps = 60;
+  for (int i = 1; i < argc; ++i) {
+    if (int used = headless_run.parse(argc, argv, i)) {
+      i += used - 1;
+    } else if (!strcmp(argv[i], "--pacing") && i + 1 < argc) {
+      if (!frame_pacer::parse(argv[++i], pacing, pacing_hz)) {
+        printf("unknown pacing mode %s\n", argv[i]);
+        return 1;
       }
-    } 
-  }
-  
-  void move_bats() {
-    // look at the keys and move the bats
-	vec4 bat_up(0, 0.02f, 0, 0);
-
-	if (key_special_states[GLUT_KEY_UP] && bats[0].t_side() <= 1) {	// test for key and paddle within viewport
-		bats[0].move(bat_up);
-		}
-	if (key_special_states[GLUT_KEY_DOWN] && bats[0].b_side() >= -1) {
-		bats[0].move(-bat_up);
-		}
-
-	// Move obstacle
-  move_obstacle = vec4(0, 0.01f, 0, 0);
-
-	if (obstacle.t_side() >= 1){
-		obstacle_switch = true;
-	}
-	if (obstacle.b_side() <= -1){
-		obstacle_switch = false;
-	}
-	if (obstacle_switch == true){
-		obstacle.move(-move_obstacle);
-	}
-	if (obstacle_switch == false){
-		obstacle.move(move_obstacle);
-	}
-  }
-
-   // called when someone scores
-  void adjust_score(int player) {
-    scores[player]++;
-    if (scores[player] > 5) {
-      state = state_end;
-	  printf("Thank you for playing!\7\7\7\n\n");
-    } else
-    {
-      server = 1 - player;
-      state = state_serving;
-    }
-  }
-  
-  void do_serving() {
-	srand(static_cast<unsigned int>(time(0)));				//seed random number
-	float random_n;
-	int lowest = -2;
-	int highest = 2;
-	int range;
-	range = (highest - lowest) + 1;
-	for(int index = 0; index < 20; index++) {
-		random_n = lowest + int(range * rand()/(RAND_MAX + 1.0));
-		if (random_n == 0.0f){
-			random_n += 1.0f;
-		}
-	}
-
-	// while serving, glue the ball to the server's bat
-    vec4 s_offset = vec4(server ? -0.1f : 0.1f, 0, 0, 0);
-    ball.set_pos(bats[server].pos() + s_offset);
-    if (keys[' '] && server == 0) {
-		state = state_playing;
-		ball_velocity = vec4(ball_speed(), -ball_speed() * random_n, 0, 0);
-	} else if (server == 1) {
-		state = state_playing;
-		ball_velocity = vec4(-ball_speed(), -ball_speed() * random_n, 0, 0);
+    } else if (!strcmp(argv[i], "--hud")) {
+      show_hud = true;
+    } else if (!strcmp(argv[i], "--particle-bench") && i + 1 < argc) {
+      return particle_benchmark((unsigned)atoi(argv[i + 1]));
+    } else if (!strcmp(argv[i], "--dynamic-res") && i + 1 < argc) {
+      dynamic_resolution::get().enable(atof(argv[++i]));
+    } else if (!strcmp(argv[i], "--capture") && i + 1 < argc) {
+      capture_file = argv[++i];
+    } else if (!strcmp(argv[i], "--capture-fps") && i + 1 < argc) {
+      capture_fps = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--gpu-times")) {
+      gpu_timers::get().enable();
+    } else if (!strcmp(argv[i], "--frame-times") && i + 1 < argc) {
+      frame_times_file = argv[++i];
+    } else if (!strcmp(argv[i], "--classic")) {
+      classic = true;
+    } else if (!strcmp(argv[i], "--level") && i + 1 < argc) {
+      if (!level_file::get().map(argv[++i])) return 1;
+    } else if (!strcmp(argv[i], "--make-level") && i + 2 < argc) {
+      level_writer writer;
+      unsigned num_obstacles = i + 3 < argc ? (unsigned)atoi(argv[i + 3]) : 0;
+      build_brick_wall_level(writer, (unsigned)atoi(argv[i + 2]), num_obstacles);
+      return writer.write(argv[i + 1]) ? 0 : 1;
     }
   }
 
-  void do_playing() 
-  {
-	// bounce the ball and detect collisions
-    vec4 new_pos = ball.pos() + ball_velocity;
-    ball.set_pos(new_pos);
-
-   // Opponent AI (Keep)
-	bat_ai = vec4(0, 0.02f, 0, 0);
-
-	if (new_pos[1] >= bats[1].pos()[1] && bats[1].t_side() <= 1) {
-		bats[1].move(bat_ai);
-	}
-	if (new_pos[1] <= bats[1].pos()[1] && bats[1].b_side() >= -1) {
-		bats[1].move(-bat_ai);
-	}
-	
-	// bounce
-    if (
-      ball_velocity[1] > 0 && new_pos[1] > court_size() ||
-      ball_velocity[1] < 0 && new_pos[1] <- court_size()
-    ) {
-      ball_velocity = ball_velocity * vec4(1, -1, 1, 1);
-    }
+  if (capture_file && !frame_capture::get().enable(capture_file, capture_fps)) return 1;
 
-    // note we don't just simply reverse the ball...
-    //   this would lead to a feedback loop.
-    if (ball_velocity[0] > 0) {
-      // right to left
-      if (new_pos[0] > 1) {
-        adjust_score(0);
-		//reset bricks
-	for (int i = 0; i <= brick_num; ++i) { 
-	 if (brick[i].pos()[1] > 1){
-		brick[i].move(-brick_kill);
-		brick_dead[i] = false;
-	  }
-    }
-      }
-      if (ball.intersects(bats[1])) {
-		ball_velocity = ball_velocity * vec4(-1.1f, 1.1f, 1, 1);
-      }
-    } else {
-      // left to right
-      if (new_pos[0] < -1) {
-        adjust_score(1);
-		//reset bricks
-	for (int i = 0; i <= brick_num; ++i) {
-	 if (brick[i].pos()[1] > 1){
-		brick[i].move(-brick_kill);
-		brick_dead[i] = false;
-	  }
-    }
-      }
-      if (ball.intersects(bats[0])) {
-		ball_velocity = ball_velocity * vec4(-1.1f, 1.1f, 1, 1);
-      }
-    }
-	//obstacle collisions
-	if (!ball.intersects(obstacle)) {
-		collision_1_test = false;
-	}
-
-	// bounces on center obstacle
-	if (ball.intersects(obstacle)) {
-		if (obstacle.t_side() >= ball.b_side() && new_pos[1] > obstacle.t_side() && collision_1_test == false) {
-			ball_velocity = ball_velocity * vec4(1, -1, 1, 1);
-			collision_1_test = true;
-		}
-		else if (obstacle.b_side() <= ball.t_side() && new_pos[1] < obstacle.b_side() && collision_1_test == false) {
-			ball_velocity = ball_velocity * vec4(1, -1, 1, 1);
-			collision_1_test = true;
-		}
-			else if (obstacle.l_side() <= ball.r_side() && new_pos[0] < obstacle.l_side() && ball.r_side() < obstacle.t_side() - 0.02f && ball.r_side() > obstacle.b_side() + 0.02f && collision_1_test == false) {
-			ball_velocity = ball_velocity * vec4(-1, 1, 1, 1);
-			collision_1_test = true;
-		}
-		else if (obstacle.r_side() >= ball.l_side() && new_pos[0] > obstacle.r_side() && ball.l_side() < obstacle.t_side() - 0.02f && ball.l_side() > obstacle.b_side() + 0.02f && collision_1_test == false) {
-			ball_velocity = ball_velocity * vec4(-1, 1, 1, 1);
-			collision_1_test = true;
-		}
-	}
-
-		//Obstacle Collision failsafe - checks if ball is within the 'frame' of the obstacle
-	vec4 xball_fix(0.05f, 0, 0, 0);
-	vec4 yball_fix(0, 0.05f, 0, 0);
-
-		if (ball.intersects(obstacle) && collision_1_test == false) { 
-			if (obstacle.t_side() - 0.03f <= ball.pos()[1] && ball.pos()[1] <= obstacle.t_side()) {
-				collision_1_test = false;
-				ball.move(yball_fix);
-				ball_velocity = ball_velocity * vec4(1, -1, 1, 1);
-			}
-			else if (obstacle.b_side() + 0.03f >= ball.pos()[1] && ball.pos()[1] >= obstacle.b_side()) {
-				collision_1_test = false;
-				ball.move(-yball_fix);
-				ball_velocity = ball_velocity * vec4(1, -1, 1, 1);
-			}
-			else if (obstacle.l_side() + 0.025f >= ball.pos()[0] && ball.pos()[0] >= obstacle.l_side() && ball.pos()[1] > obstacle.b_side() + 0.03f && ball.pos()[1] < obstacle.t_side() - 0.03f ){
-				collision_1_test = false;
-				ball.move(-xball_fix);
-				ball_velocity = ball_velocity * vec4(-1, 1, 1, 1);
-			}
-			else if (obstacle.r_side() - 0.025f <= ball.pos()[0] && ball.pos()[0] <= obstacle.r_side() && ball.pos()[1] > obstacle.b_side() + 0.03f && ball.pos()[1] < obstacle.t_side() - 0.03f ){
-				collision_1_test = false;
-				ball.move(xball_fix);
-				ball_velocity = ball_velocity * vec4(-1, 1, 1, 1);
-			}
-		}
-
-		//Brick Collisions
-	for (int i = 0; i <= brick_num; ++i) {
-	if (ball.intersects(brick[i])) { 
-		if (brick[i].t_side() >= ball.b_side() && ball.pos()[1] > brick[i].t_side()) {
-			ball_velocity = ball_velocity * vec4(1, -1, 1, 1);
-			brick_dead[i] = true;
-
-		}
-		else if (brick[i].b_side() <= ball.t_side() && ball.pos()[1] < brick[i].b_side()) {
-			ball_velocity = ball_velocity * vec4(1, -1, 1, 1);
-			brick_dead[i] = true;
-		}
-		else if (brick[i].l_side() <= ball.r_side() && ball.pos()[0] < brick[i].l_side()) {
-			ball_velocity = ball_velocity * vec4(-1, 1, 1, 1);
-			brick_dead[i] = true;
-		}
-		else if (brick[i].r_side() >= ball.l_side() && ball.pos()[0] > brick[i].r_side()) {
-			ball_velocity = ball_velocity * vec4(-1, 1, 1, 1);
-			brick_dead[i] = true;
-		}
-	}
-	}
-	for (int i = 0; i <= brick_num; ++i) {
-	if (brick[i].pos()[1] < 1){
-		brick_onscreen[i] = true;
-	}
-	}
-	for (int i = 0; i <= brick_num; ++i) {
-	if (brick[i].pos()[1] > 1){
-		brick_onscreen[i] = false;
-	}
-	}
-
-	for (int i = 0; i <= brick_num; ++i) {
-	if (brick_dead[i] == true && brick_onscreen[i] == true){
-		brick[i].move(brick_kill);
-	}
-	}
-  }
-
-  // simulation for the game
-  void simulate() {
-    move_bats();
-    
-    if (state == state_serving) {
-      do_serving();
-    } else if (state == state_playing) {
-      do_playing();
-    }
-  }
-  
-
-
-  // simulate and draw the game world every frame
-  void render() {
-     simulate();
-
-    // clear the frame buffer and the depth
-    glClearColor(0, 0, 0, 1);
-    glViewport(0, 0, viewport_width_, viewport_height_);
-    glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
-	glDisable(GL_DEPTH_TEST);
-    glActiveTexture(GL_TEXTURE0);
-	glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, background);
-	texture_shader_.render();
-
-	float vertices[4*4] = {
-      -10.0f,-10.0f,0,0,
-       10.0f,-10.0f,1,0,
-       10.0f,10.0f,1,1,
-      -10.0f,10.0f,0,1
-    };
-
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), (void*)vertices );
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), (void*)(vertices + 2) );
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(2);
-
-    // kick the draw
-    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
-
-
-    draw_world(colour_shader_);
-
-    // swap buffers so that the image is displayed.
-    // gets a new buffer to draw a new scene.
-    glutSwapBuffers();
-  }
-
-  // set up the world
-  NewPongGame()
-  {
-    memset(keys, 0, sizeof(keys));
-	memset(key_states,0,256);
-	memset(key_special_states,0,246);
-    
-    // set up game state.
-    scores[0] = 0;
-    scores[1] = 0;
-    state = state_serving;
-    server = 0;
-
-    // make the bats and ball
-    float bat_hx = 0.02f;
-    float bat_hy = 0.10f;
-    float bat_cx = 1 - bat_hx * 2;
-    bats[0].init(-bat_cx, 0, bat_hx, bat_hy);
-    bats[1].init( bat_cx, 0, bat_hx, bat_hy);
-    float ball_hx = 0.02f;
-    float ball_hy = 0.02f;
-    ball.init(0, 0, ball_hx, ball_hy);
-
-	//make the center obstacle
-	float obstacle_hx = 0.05f;
-	float obstacle_hy = 0.3f;
-	obstacle.init(0.0f, 1.1f, obstacle_hx,obstacle_hy);
-
-	//make bricks
-	float brick_hx = 0.05f;
-	float brick_hy = 0.15f;
-	//Upper left
-    brick[1].init(-0.15f, 0.8f, brick_hx, brick_hy);
-	brick[0].init(-0.30f, 0.8f, brick_hx, brick_hy);
-	brick[2].init(-0.15f, 0.45f, brick_hx, brick_hy);
-	//Upper right
-	brick[3].init(0.15f, 0.8f, brick_hx, brick_hy);
-	brick[4].init(0.30f, 0.8f, brick_hx, brick_hy);
-	brick[5].init(0.15f, 0.45f, brick_hx, brick_hy);
-	//lower left
-	brick[8].init(-0.15f, -0.8f, brick_hx, brick_hy);
-	brick[7].init(-0.30f, -0.8f, brick_hx, brick_hy);
-	brick[6].init(-0.15f, -0.45f, brick_hx, brick_hy);
-	//lower right
-	brick[10].init(0.15f, -0.8f, brick_hx, brick_hy);
-	brick[11].init(0.30f, -0.8f, brick_hx, brick_hy);
-	brick[9].init(0.15f, -0.45f, brick_hx, brick_hy);
-
-    // set up a sim(ple shader to render the emissve color
-    colour_shader_.init(
-      // just copy the position attribute to gl_Position
-      "attribute vec4 pos;"
-      "void main() { gl_Position = pos; }",
-
-      // just copy the color attribute to gl_FragColor
-      "uniform vec4 emissive_color;"
-      "void main() { gl_FragColor = emissive_color; }"
-
-    );
-	// set up a simple shader to render the emissve color
-    texture_shader_.init(
-      // just copy the position attribute to gl_Position
-      "varying vec2 uv_;"
-      "attribute vec3 pos;"
-      "attribute vec2 uv;"
-      "void main() { gl_Position = vec4(pos * 0.05, 1); uv_ = uv; }",
-
-      // just copy the color attribute to gl_FragColor
-      "varying vec2 uv_;"
-      "uniform sampler2D texture;"
-      "void main() { gl_FragColor = texture2D(texture, uv_); }"
-      //"void main() { gl_FragColor = vec4(1, 0, 0, 1); }"
-	  );
-  }
-  
-  // The viewport defines the drawing area in the window
-  void set_viewport(int w, int h) {
-    viewport_width_ = w;
-    viewport_height_ = h;
-  }
-
-  void set_key(int key, int value) {
-    keys[key & 0xff] = value;
+  if (headless_run.frames) {
+    return classic ? run_headless<NewPongGame<classic_rules> >(headless_run) : run_headless<NewPongGame<brick_rules> >(headless_run);
   }
 
-public:
-  // a singleton: one instance of this class only!
-  static NewPongGame &get()
-  {
-    static NewPongGame singleton;
-    return singleton;
-  }
-
-  // interface from GLUT
-  static void reshape(int w, int h) { get().set_viewport(w, h); }
-  static void display() { get().render(); }
-  static void timer(int value) { glutTimerFunc(30, timer, 1); glutPostRedisplay(); }
-  static void key_down( unsigned char key, int x, int y) { get().set_key(key, 1); }
-  static void key_up( unsigned char key, int x, int y) { get().set_key(key, 0); }
-
-};
-
-
-int main(int argc, char **argv) // boilerplate to run the sample
-{
   glutInit(&argc, argv);
+  #ifdef GLUT_CORE_PROFILE
+    if (headless_run.core) {
+      glutInitContextVersion(3, 3);
+      glutInitContextProfile(GLUT_CORE_PROFILE);
+    }
+  #endif
   glutInitDisplayMode(GLUT_RGBA|GLUT_DEPTH|GLUT_DOUBLE);
   glutInitWindowSize(500, 500);
-  glutCreateWindow("James Gamlin's Pong");
-
-  background = texture_manager::new_texture("texture.tga", 0, 0, 256, 256);
+  glutCreateWindow(classic ? classic_rules::title() : brick_rules::title());
 
+  gl_load_entry_points();
   #ifdef WIN32
-    glewInit();
     if (!glewIsSupported("GL_VERSION_2_0") )
     {
       printf("OpenGL 2 is required!\n");
       return 1;
     }
   #endif
-  glutDisplayFunc(NewPongGame::display);
-  glutReshapeFunc(NewPongGame::reshape);
-  glutKeyboardFunc(NewPongGame::key_down);
-  glutKeyboardUpFunc(NewPongGame::key_up);
-  glutTimerFunc(30, NewPongGame::timer, 1);
-  glutSpecialFunc(keySpecial);
-  glutSpecialUpFunc(keySpecialUp);
+
+  // after glewInit: textures are bound through gl_state
+  background = texture_atlas::get().add("texture.tga", 0, 0, 256, 256);
+  frame_pacer::get().set_mode(pacing, pacing_hz);
+  atexit(report_frame_times);
+  atexit(finish_capture);
+  #ifdef GLUT_ACTION_ON_WINDOW_CLOSE
+    // freeglut destroys the window before exit() runs the atexit handlers
+    glutCloseFunc(finish_capture);
+  #endif
+
+  // the mode is picked once here: each one is its own instantiation
+  if (classic) {
+    NewPongGame<classic_rules>::install();
+  } else {
+    NewPongGame<brick_rules>::install();
+  }
   glutMainLoop();
 
   return 0;
-}
\ No newline at end of file
+}